@@ -32,102 +32,58 @@ create_test_file() {
     echo "Test file created successfully"
 }
 
-# Function to check if a test has been completed
-is_test_completed() {
-    local output_file=$1
-    local operation=$2
-    local io_size=$3
-    local stride_size=$4
-    local is_random=$5
-
-    # If file doesn't exist, test hasn't been run
-    [ ! -f "$output_file" ] && return 1
-
-    # Check if we have all iterations for this configuration
-    completed_iterations=$(grep "^$operation,$io_size,$stride_size,$is_random" "$output_file" | wc -l)
-    [ "$completed_iterations" -eq "$ITERATIONS" ]
-    return $?
+# Completed points are recorded here, so rerunning the script resumes where it stopped
+JOURNAL="$OUTPUT_DIR/progress.journal"
+
+# Join an array into the comma-separated list the benchmark sweeps over
+join_list() {
+    local IFS=,
+    echo "$*"
 }
 
+# Random runs use a smaller multiplier for larger IO sizes
+RANDOM_SMALL_SIZES=4096,8192,16384,32768
+RANDOM_MEDIUM_SIZES=65536,131072,262144,524288
+RANDOM_LARGE_SIZES=1048576,2097152,4194304,8388608,16777216,33554432,67108864,104857600
+
 # Function to run benchmarks
 run_benchmark_set() {
     local name=$1
     local output_file="$OUTPUT_DIR/${name}.csv"
+    local io_sizes=$(join_list "${IO_SIZES[@]}")
+    local stride_io_sizes=$(join_list "${STRIDE_IO_SIZES[@]}")
+    local strides=$(join_list "${STRIDE_SIZES[@]}")
+    local common="-d $DEVICE -n $ITERATIONS --journal $JOURNAL -o $output_file"
 
     echo "Running $name benchmarks..."
 
-    # Create header if file doesn't exist
-    if [ ! -f "$output_file" ]; then
-        echo "operation,io_size,stride_size,is_random,iteration,throughput,mean,stddev,ci95" > "$output_file"
-    fi
-
     case $name in
         "sequential_size_read")
-            for size in "${IO_SIZES[@]}"; do
-                if ! is_test_completed "$output_file" "read" "$size" "0" "false"; then
-                    ./benchmark -d $DEVICE -s $size -n $ITERATIONS -m 1000 -o "$output_file"
-                fi
-            done
+            ./benchmark $common -s $io_sizes -m 1000
             ;;
 
         "sequential_size_write")
-            for size in "${IO_SIZES[@]}"; do
-                if ! is_test_completed "$output_file" "write" "$size" "0" "false"; then
-                    ./benchmark -d $DEVICE -s $size -n $ITERATIONS -m 1000 -w -o "$output_file"
-                fi
-            done
+            ./benchmark $common -s $io_sizes -m 1000 -w
             ;;
 
         "stride_read")
-            for io_size in "${STRIDE_IO_SIZES[@]}"; do
-                for stride in "${STRIDE_SIZES[@]}"; do
-                    if ! is_test_completed "$output_file" "read" "$io_size" "$stride" "false"; then
-                        ./benchmark -d $DEVICE -s $io_size -t $stride -n $ITERATIONS -m 5 -o "$output_file"
-                    fi
-                done
-            done
+            ./benchmark $common -s $stride_io_sizes -t $strides -m 5
             ;;
 
         "stride_write")
-            for io_size in "${STRIDE_IO_SIZES[@]}"; do
-                for stride in "${STRIDE_SIZES[@]}"; do
-                    if ! is_test_completed "$output_file" "write" "$io_size" "$stride" "false"; then
-                        ./benchmark -d $DEVICE -s $io_size -t $stride -n $ITERATIONS -m 5 -w -o "$output_file"
-                    fi
-                done
-            done
+            ./benchmark $common -s $stride_io_sizes -t $strides -m 5 -w
             ;;
 
-"random_read")
-            for size in "${IO_SIZES[@]}"; do
-                if ! is_test_completed "$output_file" "read" "$size" "0" "true"; then
-                    # Use smaller multiplier for larger IO sizes
-                    if [ "$size" -lt 65536 ]; then
-                        multiplier=500
-                    elif [ "$size" -lt 1048576 ]; then
-                        multiplier=100
-                    else
-                        multiplier=50
-                    fi
-                    ./benchmark -d $DEVICE -s $size -R -n $ITERATIONS -m $multiplier -o "$output_file"
-                fi
-            done
+        "random_read")
+            ./benchmark $common -s $RANDOM_SMALL_SIZES -R -m 500
+            ./benchmark $common -s $RANDOM_MEDIUM_SIZES -R -m 100
+            ./benchmark $common -s $RANDOM_LARGE_SIZES -R -m 50
             ;;
 
         "random_write")
-            for size in "${IO_SIZES[@]}"; do
-                if ! is_test_completed "$output_file" "write" "$size" "0" "true"; then
-                    # Use smaller multiplier for larger IO sizes
-                    if [ "$size" -lt 65536 ]; then
-                        multiplier=500
-                    elif [ "$size" -lt 1048576 ]; then
-                        multiplier=100
-                    else
-                        multiplier=50
-                    fi
-                    ./benchmark -d $DEVICE -s $size -R -w -n $ITERATIONS -m $multiplier -o "$output_file"
-                fi
-            done
+            ./benchmark $common -s $RANDOM_SMALL_SIZES -R -w -m 500
+            ./benchmark $common -s $RANDOM_MEDIUM_SIZES -R -w -m 100
+            ./benchmark $common -s $RANDOM_LARGE_SIZES -R -w -m 50
             ;;
     esac
 }
@@ -147,7 +103,7 @@ else
 fi
 
 # Compile the benchmark program
-gcc -O2 benchmark.c -lm -o benchmark
+gcc -O2 benchmark.c -lm -lpthread -o benchmark
 
 run_benchmark_set "sequential_size_read"
 run_benchmark_set "sequential_size_write"
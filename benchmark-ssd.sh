@@ -20,6 +20,9 @@ STRIDE_IO_SIZES=(4096 65536 524288 1048576 10485760)
 # Number of iterations
 ITERATIONS=5
 
+# Write sets start from a preconditioned drive and measure only once throughput is steady
+PRECONDITION="--precondition 2 --steady-state 5"
+
 # Create initial test file with random data
 create_test_file() {
     echo "Creating 1GB test file with random data..."
@@ -32,52 +35,46 @@ create_test_file() {
     echo "Test file created successfully"
 }
 
+# Join an array into the comma-separated list the benchmark sweeps over
+join_list() {
+    local IFS=,
+    echo "$*"
+}
+
 # Function to run benchmarks
+# Each set is a single sweep: one process covers every size/stride point, reusing its fd and buffers
 run_benchmark_set() {
     local name=$1
     local output_file="$OUTPUT_DIR/${name}.csv"
+    local io_sizes=$(join_list "${IO_SIZES[@]}")
+    local stride_io_sizes=$(join_list "${STRIDE_IO_SIZES[@]}")
+    local strides=$(join_list "${STRIDE_SIZES[@]}")
 
     echo "Running $name benchmarks..."
 
     case $name in
         "sequential_size_read")
-            for size in "${IO_SIZES[@]}"; do
-                ./benchmark -d $DEVICE -s $size -n $ITERATIONS -o "$output_file"
-            done
+            ./benchmark -d $DEVICE -s $io_sizes -n $ITERATIONS -o "$output_file"
             ;;
 
         "sequential_size_write")
-            for size in "${IO_SIZES[@]}"; do
-                ./benchmark -d $DEVICE -s $size -n $ITERATIONS -w -o "$output_file"
-            done
+            ./benchmark -d $DEVICE -s $io_sizes -n $ITERATIONS -w $PRECONDITION -o "$output_file"
             ;;
 
         "stride_read")
-            for io_size in "${STRIDE_IO_SIZES[@]}"; do
-                for stride in "${STRIDE_SIZES[@]}"; do
-                    ./benchmark -d $DEVICE -s $io_size -t $stride -n $ITERATIONS -o "$output_file"
-                done
-            done
+            ./benchmark -d $DEVICE -s $stride_io_sizes -t $strides -n $ITERATIONS -o "$output_file"
             ;;
 
         "stride_write")
-            for io_size in "${STRIDE_IO_SIZES[@]}"; do
-                for stride in "${STRIDE_SIZES[@]}"; do
-                    ./benchmark -d $DEVICE -s $io_size -t $stride -n $ITERATIONS -w -o "$output_file"
-                done
-            done
+            ./benchmark -d $DEVICE -s $stride_io_sizes -t $strides -n $ITERATIONS -w $PRECONDITION -o "$output_file"
             ;;
 
         "random_read")
-            for size in "${IO_SIZES[@]}"; do
-                ./benchmark -d $DEVICE -s $size -R -n $ITERATIONS -o "$output_file"
-            done
+            ./benchmark -d $DEVICE -s $io_sizes -R -n $ITERATIONS -o "$output_file"
             ;;
 
         "random_write")
-            for size in "${IO_SIZES[@]}"; do
-                ./benchmark -d $DEVICE -s $size -R -w -n $ITERATIONS -o "$output_file"
-            done
+            ./benchmark -d $DEVICE -s $io_sizes -R -w -n $ITERATIONS $PRECONDITION -o "$output_file"
             ;;
     esac
 }
@@ -97,7 +94,7 @@ else
 fi
 
 # Compile the benchmark program
-gcc -O2 benchmark.c -lm -o benchmark
+gcc -O2 benchmark.c -lm -lpthread -o benchmark
 
 run_benchmark_set "sequential_size_read"
 run_benchmark_set "sequential_size_write"
@@ -9,251 +9,3471 @@
 #include <getopt.h>
 #include <errno.h>
 #include <math.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/aio_abi.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <ctype.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <linux/futex.h>
 
 #define BILLION 1000000000L
 #define GB (1024*1024*1024L)
 #define MB (1024*1024L)
 #define KB 1024
+#define TB (1024*GB)
+// Largest single read()/write() Linux performs, rounded down to 4K
+#define MAX_IO_SIZE 0x7ffff000L
+
+// Log-linear latency histogram in the spirit of HdrHistogram: 64 linear sub-buckets per
+// power of two keeps every bucket within ~1.6% of its value, tracking up to 2^42 ns (~73 min)
+#define HIST_SUB_BITS 7
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_HALF_COUNT (HIST_SUB_COUNT / 2)
+#define HIST_MAX_BITS 42
+#define FEISTEL_ROUNDS 4
+#define MAX_ITERATIONS 10000
+#define PRECONDITION_SEQ_SIZE (128 * KB)
+#define PRECONDITION_RANDOM_SIZE (4 * KB)
+// SNIA PTS steady-state criteria, as percentages of the window's average throughput
+#define STEADY_RANGE_PCT 20
+#define STEADY_SLOPE_PCT 10
+// --rate workers sleep until this close to an I/O's send time, then spin for precision
+#define RATE_SPIN_NS 50000
+#define KNEE_MAX_STEPS 64
+#define SQPOLL_IDLE_MS 1000  // How long an idle SQPOLL thread spins before it sleeps
+#define QUEUE_SPINS 128      // Failed polls of the threadpool queue before a thread sleeps on it
+#define HUGE_2MB (2 * MB)
+#define HUGE_1GB GB
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#define KNEE_DEFAULT_MAX_DEPTH 256
+#define KNEE_GAIN_PCT 10             // Throughput growing less than this per doubling of the load marks the knee
+#define KNEE_P99_GROWTH_PCT 20       // ...provided p99 grows at least this much at the next step
+#define KNEE_RATE_RESOLUTION 1.05    // Open-loop bisection stops once the bounds are this close
+#define KNEE_SATURATION 0.9          // Open-loop loads must achieve this share of the offered rate
+#define HIST_BUCKETS (HIST_SUB_COUNT + (HIST_MAX_BITS - HIST_SUB_BITS) * HIST_HALF_COUNT)
+
+typedef enum {
+    ENGINE_SYNC,  // Positional pread/pwrite
+    ENGINE_LSEEK, // Legacy lseek + read/write, the only sync path before pread became the default
+    ENGINE_IO_URING,
+    ENGINE_LIBAIO,
+    ENGINE_PVSYNC2,
+    ENGINE_THREADPOOL  // Producer thread feeding blocking pread/pwrite workers through a queue
+} io_engine;
+
+typedef enum {
+    DIST_UNIFORM,
+    DIST_PERMUTE,
+    DIST_ZIPF,
+    DIST_PARETO,
+    DIST_HOTCOLD
+} offset_dist;
+
+typedef enum {
+    ARRIVAL_FIXED,
+    ARRIVAL_POISSON
+} arrival_process;
 
 typedef struct {
     char* device;
-    int io_size;
-    int stride_size;
+    long io_size;
+    long stride_size;
     long range;
     int is_write;
+    int rwmix_read;  // Percentage of reads in a mixed run, -1 when is_write alone decides
     int is_random;
-    int num_iterations;
+    offset_dist dist;
+    double zipf_theta;
+    double pareto_h;
+    double hot_io_pct;     // Share of I/Os sent to the hot set
+    double hot_range_pct;  // Share of the range that forms the hot set
+    int num_iterations;  // Minimum number of iterations when target_ci is set
+    double target_ci;    // Relative 95% CI half-width (percent) to stop at, 0 runs exactly num_iterations
+    int max_iterations;  // Iteration budget for --target-ci
+    double max_time;     // Seconds budget per point for --target-ci, 0 for none
+    int precondition_passes;  // Range-sized sequential then random write passes before a job
+    int steady_window;        // Rounds in the steady-state window, 0 measures straight away
+    int steady_max_rounds;    // Rounds to give up on steady state after
+    char* log_file;
+    int log_interval_ms;
+    struct interval_log* series;  // Open time-series log, shared by every run of the job
+    struct buffer_pool* pool;     // Process-wide I/O buffers
+    int hugepages;  // Back the buffer pool with huge pages when possible
+    int fixed;      // io_uring registered buffers and fixed files
+    int sqpoll;     // io_uring kernel submission-polling thread
+    int sqpoll_cpu; // CPU to pin the SQPOLL thread to, -1 to let it float
+    int iopoll;     // io_uring polled completions instead of interrupts
+    int batch_submit;    // Most I/Os an async engine submits per syscall, 0 for all that are ready
+    int batch_complete;  // Completions an async engine waits for per syscall
+    int num_iovecs;      // Segments of each pvsync2 I/O
+    long* iovec_sizes;   // Explicit pvsync2 segment sizes, NULL splits the I/O evenly
+    int rwf_flags;       // RWF_* flags passed to preadv2/pwritev2
+    int shared_fd;       // All workers use one fd, which needs an engine without a file position
+    int compare_lseek;   // Rerun sync points on the lseek engine and report the difference
     char* output_file;
+    char* journal_file;
     long io_multiplier;
+    io_engine engine;
+    int queue_depth;
+    int num_threads;
+    double runtime;  // Seconds per iteration; 0 runs the -m I/O count instead
+    double ramp;     // Seconds of warm-up per iteration left out of the stats
+    double knee_slo_us;  // p99 SLO of a knee search, 0 runs the points as given
+    double rate;  // Total IOPS issued open-loop, 0 issues each I/O as soon as a slot frees up
+    arrival_process arrival;
+    uint64_t seed;
+    uint64_t next_seed;  // Advanced by every run so iterations get fresh but reproducible streams
 } benchmark_config;
 
+// xoshiro256** generator, one per worker so offset generation never takes a lock
+typedef struct {
+    uint64_t s[4];
+} rng_state;
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} latency_histogram;
+
+enum { DIR_READ, DIR_WRITE };
+
+// Outcome of one run_benchmark() call, overall and split by I/O direction
+typedef struct {
+    double throughput;
+    double dir_throughput[2];
+    latency_histogram latency;
+    latency_histogram dir_latency[2];
+    double cpu_cores;      // CPU time of the process per wall-clock second of the run
+    double iops_per_core;  // IOPS per fully busy CPU core
+    double syscalls_per_io;
+    double ctx_switches_per_io;  // Voluntary and involuntary context switches of the process
+} run_result;
+
+// Streaming mean and sum of squared deviations (Welford), stable however large the values are
+typedef struct {
+    long n;
+    double mean;
+    double m2;
+} welford;
+
+// Throughput statistics across the iterations completed so far
+typedef struct {
+    double mean;
+    double stddev;  // Sample standard deviation (n - 1 denominator)
+    double ci95;    // Half-width of the Student-t 95% confidence interval
+    double median;
+    double mad;     // Median absolute deviation from the median
+} throughput_stats;
+
+// What a point achieved across all its iterations
+typedef struct {
+    double iops;
+    double mean_us;
+    double p99_us;
+    double syscalls_per_io;
+} point_outcome;
+
+// One load level measured by a knee search
+typedef struct {
+    double load;  // Queue depth, or offered IOPS with --rate
+    double iops;
+    double p99_us;
+    int ok;       // Met the SLO and, open-loop, kept up with the offered rate
+} knee_step;
+
+// How a point reached the state its iterations measure
+typedef struct {
+    int rounds;   // Unrecorded rounds run before measuring
+    int reached;  // Whether the steady-state criteria were met within the round budget
+} steady_state;
+
+// Keyed bijection over [0, num_slots), evaluated in O(1) memory however large the range is
+typedef struct {
+    uint64_t num_slots;
+    int half_bits;
+    uint64_t half_mask;
+    uint64_t keys[FEISTEL_ROUNDS];
+} feistel_perm;
+
+// Rejection-inversion Zipf sampler (Hormann & Derflinger): O(1) setup and expected O(1) per sample,
+// so unlike the zeta-sum method it needs no pass over the billions of slots of a large device
+typedef struct {
+    uint64_t n;
+    double exponent;
+    double h_integral_x1;
+    double h_integral_n;
+    double s;
+} zipf_gen;
+
+// Per-thread fd and buffers, set up once per job and reused by every run and sweep point
+typedef struct {
+    int fd;
+    char* buffers;  // Slice of the process-wide buffer_pool
+} worker_resources;
+
+// I/O buffer memory mapped once per process and only remapped when a job needs more. Huge
+// pages keep TLB misses off the I/O path, and locking keeps the pages resident
+typedef struct buffer_pool {
+    char* base;
+    size_t size;
+    const char* backing;  // Page type actually obtained, for the run header
+    int locked;
+} buffer_pool;
+
+#define MAX_SWEEP_VALUES 256
+
+typedef struct {
+    int count;
+    long values[MAX_SWEEP_VALUES];
+} sweep_list;
+
+// Values swept in one process; a list holding a single value pins that parameter
+typedef struct {
+    sweep_list io_sizes;
+    sweep_list strides;
+    sweep_list depths;
+} sweep_spec;
+
+// Durable record of finished sweep points, keyed by a hash of everything that shapes a result.
+// Lines are "start <hash> <csv size> <csv path>" before a point and "done <hash> <description>"
+// after it, each fsync'ed, so a crash mid-point can be rolled back to the CSV size it started at
+typedef struct {
+    FILE* fp;
+    uint64_t* done;  // Open-addressing set of finished hashes, 0 marks an empty slot
+    size_t capacity;
+    size_t count;
+} progress_journal;
+
+// Counters a worker bumps on every completion for the time-series sampler. Each has a single
+// writer, so a relaxed load and store is enough and the hot loop never takes a locked instruction
+typedef struct {
+    _Atomic uint64_t ios[2];
+    _Atomic uint64_t bytes[2];
+    _Atomic uint64_t latency[HIST_BUCKETS];  // Same buckets as latency_histogram
+} live_counters;
+
+typedef struct interval_log {
+    FILE* fp;
+    int run;            // run_benchmark() calls logged so far
+    const char* phase;  // What the current run is for: precondition, steady or measure
+} interval_log;
+
+// Samples the workers' live counters every log_interval_ms until stopped
+typedef struct {
+    benchmark_config* config;
+    live_counters* live;
+    int num_workers;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} sampler;
+
+// Per-thread state: every worker has its own fd, buffers, RNG and slice of the range
+typedef struct {
+    benchmark_config* config;
+    int id;
+    long base;
+    long range;
+    long current_pos;
+    long num_ios;
+    long claimed_ios;
+    uint64_t measure_start_ns;  // I/Os completing before this are ramp-up and not recorded
+    uint64_t deadline_ns;       // Set with --runtime, replaces the num_ios budget
+    double next_send_ns;        // Intended send time of the next I/O with --rate
+    double mean_gap_ns;         // Mean time between this worker's sends with --rate
+    rng_state rng;
+    uint64_t perm_key;
+    uint64_t perm_pass;
+    uint64_t perm_index;
+    feistel_perm perm;
+    zipf_gen zipf;
+    int fd;
+    char* buffers;
+    long bytes[2];
+    long syscalls;        // I/O syscalls, ramp-up included
+    long completed_ios;   // Completions, ramp-up included, to divide syscalls by
+    double start;
+    double end;
+    latency_histogram latency[2];
+    live_counters* live;  // Set when a time-series log samples this worker
+    struct request_queue* queue;  // Threadpool engine: where the producer hands this worker its I/Os
+    pthread_barrier_t* barrier;
+} worker;
+
 double get_time() {
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
     return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
-void validate_config(benchmark_config* config) {
-    if (config->io_size % 4096 != 0) {
-        fprintf(stderr, "Error: I/O size must be 4K aligned\n");
+uint64_t get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * BILLION + ts.tv_nsec;
+}
+
+uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(rng_state* rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix64(&seed);
+    }
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(rng_state* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+// Uniform value in [0, bound) using Lemire's multiply-shift, rejecting the biased low slice
+static inline uint64_t rng_bounded(rng_state* rng, uint64_t bound) {
+    __uint128_t m = (__uint128_t)rng_next(rng) * bound;
+    uint64_t low = (uint64_t)m;
+    if (low < bound) {
+        uint64_t threshold = -bound % bound;
+        while (low < threshold) {
+            m = (__uint128_t)rng_next(rng) * bound;
+            low = (uint64_t)m;
+        }
+    }
+    return (uint64_t)(m >> 64);
+}
+
+void perm_init(feistel_perm* perm, uint64_t num_slots, uint64_t key) {
+    int bits = 1;
+    while (bits < 64 && (1ULL << bits) < num_slots) {
+        bits++;
+    }
+    perm->num_slots = num_slots;
+    perm->half_bits = (bits + 1) / 2;
+    perm->half_mask = (1ULL << perm->half_bits) - 1;
+    for (int i = 0; i < FEISTEL_ROUNDS; i++) {
+        perm->keys[i] = splitmix64(&key);
+    }
+}
+
+uint64_t perm_apply(const feistel_perm* perm, uint64_t index) {
+    // Cycle-walk: the Feistel domain is under 4x num_slots, so few rounds are ever repeated
+    do {
+        uint64_t left = index >> perm->half_bits;
+        uint64_t right = index & perm->half_mask;
+        for (int i = 0; i < FEISTEL_ROUNDS; i++) {
+            uint64_t mix = right ^ perm->keys[i];
+            uint64_t f = splitmix64(&mix) & perm->half_mask;
+            uint64_t next = left ^ f;
+            left = right;
+            right = next;
+        }
+        index = (left << perm->half_bits) | right;
+    } while (index >= perm->num_slots);
+    return index;
+}
+
+// Uniform double in [0, 1) from the top 53 bits
+static inline double rng_double(rng_state* rng) {
+    return (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+static double zipf_helper1(double x) {
+    return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static double zipf_helper2(double x) {
+    return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+}
+
+static double zipf_h(const zipf_gen* z, double x) {
+    return exp(-z->exponent * log(x));
+}
+
+static double zipf_h_integral(const zipf_gen* z, double x) {
+    double log_x = log(x);
+    return zipf_helper2((1 - z->exponent) * log_x) * log_x;
+}
+
+static double zipf_h_integral_inverse(const zipf_gen* z, double x) {
+    double t = x * (1 - z->exponent);
+    if (t < -1) t = -1;
+    return exp(zipf_helper1(t) * x);
+}
+
+void zipf_init(zipf_gen* z, uint64_t n, double exponent) {
+    z->n = n;
+    z->exponent = exponent;
+    z->h_integral_x1 = zipf_h_integral(z, 1.5) - 1;
+    z->h_integral_n = zipf_h_integral(z, n + 0.5);
+    z->s = 2 - zipf_h_integral_inverse(z, zipf_h_integral(z, 2.5) - zipf_h(z, 2));
+}
+
+// Returns a rank in [0, n), rank 0 being the most popular
+uint64_t zipf_next(const zipf_gen* z, rng_state* rng) {
+    for (;;) {
+        double u = z->h_integral_n + rng_double(rng) * (z->h_integral_x1 - z->h_integral_n);
+        double x = zipf_h_integral_inverse(z, u);
+        double k = floor(x + 0.5);
+        if (k < 1) k = 1;
+        else if (k > (double)z->n) k = (double)z->n;
+        if (k - x <= z->s || u >= zipf_h_integral(z, k + 0.5) - zipf_h(z, k)) {
+            return (uint64_t)k - 1;
+        }
+    }
+}
+
+// Pareto-shaped rank in [0, n): the hottest h of the ranks receive 1 - h of the samples
+uint64_t pareto_next(double h, uint64_t n, rng_state* rng) {
+    double exponent = log(h) / log(1 - h);
+    uint64_t rank = (uint64_t)(pow(rng_double(rng), exponent) * n);
+    return rank < n ? rank : n - 1;
+}
+
+void hist_reset(latency_histogram* hist) {
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+int hist_index(uint64_t value) {
+    if (value < HIST_SUB_COUNT) {
+        return (int)value;
+    }
+    int shift = (63 - __builtin_clzll(value)) - (HIST_SUB_BITS - 1);
+    int index = HIST_SUB_COUNT + (shift - 1) * HIST_HALF_COUNT + (int)((value >> shift) - HIST_HALF_COUNT);
+    return index < HIST_BUCKETS ? index : HIST_BUCKETS - 1;
+}
+
+// Highest value that still maps to the given bucket
+uint64_t hist_bucket_value(int index) {
+    if (index < HIST_SUB_COUNT) {
+        return index;
+    }
+    int shift = (index - HIST_SUB_COUNT) / HIST_HALF_COUNT + 1;
+    uint64_t sub = (index - HIST_SUB_COUNT) % HIST_HALF_COUNT + HIST_HALF_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+void hist_record(latency_histogram* hist, uint64_t value) {
+    hist->counts[hist_index(value)]++;
+    hist->total++;
+    hist->sum += value;
+    if (value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+}
+
+void hist_merge(latency_histogram* dst, const latency_histogram* src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hist_percentile(const latency_histogram* hist, double percentile) {
+    if (hist->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)ceil(percentile / 100.0 * hist->total);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            uint64_t value = hist_bucket_value(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+double hist_mean(const latency_histogram* hist) {
+    return hist->total ? hist->sum / hist->total : 0;
+}
+
+void welford_add(welford* w, double value) {
+    w->n++;
+    double delta = value - w->mean;
+    w->mean += delta / w->n;
+    w->m2 += delta * (value - w->mean);
+}
+
+double welford_stddev(const welford* w) {
+    return w->n > 1 ? sqrt(w->m2 / (w->n - 1)) : 0;
+}
+
+// Two-sided 95% critical value of Student's t with df degrees of freedom
+double t_critical_95(long df) {
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    if (df < 1) {
+        return 0;
+    }
+    if (df <= 30) {
+        return table[df - 1];
+    }
+    // Cornish-Fisher expansion around the normal quantile, within 1e-3 beyond df = 30
+    double z = 1.959964, z3 = z * z * z, z5 = z3 * z * z;
+    return z + (z3 + z) / (4.0 * df) + (5 * z5 + 16 * z3 + 3 * z) / (96.0 * df * df);
+}
+
+int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Median of values[0, n), sorting the array in place
+double median_sorted(double* values, int n) {
+    qsort(values, n, sizeof(double), compare_double);
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+void compute_stats(const welford* acc, const double* values, int n, throughput_stats* stats) {
+    double scratch[n];
+    stats->mean = acc->mean;
+    stats->stddev = welford_stddev(acc);
+    stats->ci95 = t_critical_95(acc->n - 1) * stats->stddev / sqrt(acc->n);
+    memcpy(scratch, values, n * sizeof(double));
+    stats->median = median_sorted(scratch, n);
+    for (int i = 0; i < n; i++) {
+        scratch[i] = fabs(values[i] - stats->median);
+    }
+    stats->mad = median_sorted(scratch, n);
+}
+
+void validate_config(benchmark_config* config) {
+    if (config->io_size % 4096 != 0) {
+        fprintf(stderr, "Error: I/O size must be 4K aligned\n");
+        exit(1);
+    }
+    if (config->stride_size % 4096 != 0) {
+        fprintf(stderr, "Error: Stride size must be 4K aligned\n");
+        exit(1);
+    }
+    if (config->io_size <= 0 || config->io_size > MAX_IO_SIZE) {
+        fprintf(stderr, "Error: I/O size must be between 4K and %ld bytes\n", MAX_IO_SIZE);
+        exit(1);
+    }
+    if (config->stride_size < 0) {
+        fprintf(stderr, "Error: Stride size must not be negative\n");
+        exit(1);
+    }
+    if (config->range < config->io_size) {
+        fprintf(stderr, "Error: Range must be larger than I/O size\n");
+        exit(1);
+    }
+    if (config->queue_depth < 1 || config->queue_depth > 4096) {
+        fprintf(stderr, "Error: Queue depth must be between 1 and 4096\n");
+        exit(1);
+    }
+    if (config->rwmix_read < -1 || config->rwmix_read > 100) {
+        fprintf(stderr, "Error: Read percentage for --rwmix must be between 0 and 100\n");
+        exit(1);
+    }
+    if (config->zipf_theta <= 0) {
+        fprintf(stderr, "Error: Zipf theta must be positive\n");
+        exit(1);
+    }
+    if (config->pareto_h <= 0 || config->pareto_h >= 1) {
+        fprintf(stderr, "Error: Pareto h must be between 0 and 1\n");
+        exit(1);
+    }
+    if (config->hot_io_pct < 0 || config->hot_io_pct > 100 ||
+        config->hot_range_pct <= 0 || config->hot_range_pct > 100) {
+        fprintf(stderr, "Error: Hot/cold percentages must be within 0-100\n");
+        exit(1);
+    }
+    if (config->runtime < 0 || config->ramp < 0) {
+        fprintf(stderr, "Error: Runtime and ramp must not be negative\n");
+        exit(1);
+    }
+    if (config->num_threads < 1) {
+        fprintf(stderr, "Error: Number of threads must be at least 1\n");
+        exit(1);
+    }
+    if (config->num_iterations < 1 || config->num_iterations > MAX_ITERATIONS) {
+        fprintf(stderr, "Error: Number of iterations must be between 1 and %d\n", MAX_ITERATIONS);
+        exit(1);
+    }
+    if (config->target_ci < 0 || config->max_time < 0) {
+        fprintf(stderr, "Error: Target CI and max time must not be negative\n");
+        exit(1);
+    }
+    if (config->num_iovecs < 1 || config->num_iovecs > IOV_MAX) {
+        fprintf(stderr, "Error: Number of iovecs must be between 1 and %d\n", IOV_MAX);
+        exit(1);
+    }
+    if ((config->num_iovecs > 1 || config->rwf_flags) && config->engine != ENGINE_PVSYNC2) {
+        fprintf(stderr, "Error: --iovecs, --iovec-sizes and --rwf need the pvsync2 engine\n");
+        exit(1);
+    }
+    if (config->iovec_sizes) {
+        long total = 0;
+        for (int i = 0; i < config->num_iovecs; i++) {
+            if (config->iovec_sizes[i] <= 0 || config->iovec_sizes[i] % 4096 != 0) {
+                fprintf(stderr, "Error: iovec sizes must be positive multiples of 4K\n");
+                exit(1);
+            }
+            total += config->iovec_sizes[i];
+        }
+        if (total != config->io_size) {
+            fprintf(stderr, "Error: iovec sizes add up to %ld bytes, not the I/O size of %ld\n", total, config->io_size);
+            exit(1);
+        }
+    } else if (config->num_iovecs > config->io_size / 4096) {
+        fprintf(stderr, "Error: A %ld-byte I/O cannot be split into %d 4K-aligned iovecs\n",
+                config->io_size, config->num_iovecs);
+        exit(1);
+    }
+    if (config->shared_fd && (config->engine == ENGINE_LSEEK || config->compare_lseek)) {
+        fprintf(stderr, "Error: --shared-fd cannot be used with the lseek engine, whose threads would share a file position\n");
+        exit(1);
+    }
+    if (config->batch_submit < 0 || config->batch_complete < 1) {
+        fprintf(stderr, "Error: Batch submit must not be negative and batch complete must be at least 1\n");
+        exit(1);
+    }
+    if ((config->sqpoll || config->iopoll) && config->engine != ENGINE_IO_URING) {
+        fprintf(stderr, "Error: --sqpoll and --iopoll need the io_uring engine\n");
+        exit(1);
+    }
+    if (config->fixed && (config->engine != ENGINE_IO_URING || config->io_size > GB)) {
+        fprintf(stderr, "Error: --fixed needs the io_uring engine and I/Os of at most 1G\n");
+        exit(1);
+    }
+    if (config->knee_slo_us < 0) {
+        fprintf(stderr, "Error: Knee p99 SLO must not be negative\n");
+        exit(1);
+    }
+    if (config->rate < 0) {
+        fprintf(stderr, "Error: Rate must not be negative\n");
+        exit(1);
+    }
+    if (config->log_interval_ms < 1) {
+        fprintf(stderr, "Error: Log interval must be at least 1 ms\n");
+        exit(1);
+    }
+    if (config->precondition_passes < 0) {
+        fprintf(stderr, "Error: Precondition passes must not be negative\n");
+        exit(1);
+    }
+    if (config->steady_window == 1 || config->steady_window < 0 ||
+        (config->steady_window > 0 && config->steady_max_rounds < config->steady_window) ||
+        config->steady_max_rounds > MAX_ITERATIONS) {
+        fprintf(stderr, "Error: Steady-state window must be 0 or at least 2, with max rounds between it and %d\n",
+                MAX_ITERATIONS);
+        exit(1);
+    }
+    if (config->target_ci > 0 &&
+        (config->max_iterations < config->num_iterations || config->max_iterations > MAX_ITERATIONS)) {
+        fprintf(stderr, "Error: Max iterations must be between -n and %d\n", MAX_ITERATIONS);
+        exit(1);
+    }
+    // Sequential and stride workers each get a disjoint slice, which must still hold one I/O.
+    // The threadpool producer walks the whole range on its own
+    int slices = config->engine == ENGINE_THREADPOOL ? 1 : config->num_threads;
+    if (!config->is_random && config->range / slices / 4096 * 4096 < config->io_size) {
+        fprintf(stderr, "Error: Range is too small to give each of %d threads an I/O-sized slice\n",
+                config->num_threads);
+        exit(1);
+    }
+    // Permute workers start at their own slot of the shared permutation, so each needs one
+    if (config->is_random && config->dist == DIST_PERMUTE && config->range / config->io_size < slices) {
+        fprintf(stderr, "Error: --dist permute needs a range of at least one I/O per thread (%d)\n",
+                config->num_threads);
+        exit(1);
+    }
+}
+
+const char* engine_name(io_engine engine) {
+    switch (engine) {
+        case ENGINE_IO_URING: return "io_uring";
+        case ENGINE_LIBAIO: return "libaio";
+        case ENGINE_PVSYNC2: return "pvsync2";
+        case ENGINE_LSEEK: return "lseek";
+        case ENGINE_THREADPOOL: return "threadpool";
+        case ENGINE_SYNC:
+        default: return "sync";
+    }
+}
+
+// Async engines keep queue_depth I/Os in flight; the others issue one at a time per thread
+int engine_is_async(io_engine engine) {
+    return engine == ENGINE_IO_URING || engine == ENGINE_LIBAIO;
+}
+
+// Engines that take -q: the async ones, and the threadpool whose queue it sizes
+int engine_uses_depth(io_engine engine) {
+    return engine_is_async(engine) || engine == ENGINE_THREADPOOL;
+}
+
+// Formats the RWF_* flags as a '|'-separated list, or "-" when there are none
+void format_rwf(int flags, char* buf, size_t len) {
+    snprintf(buf, len, "%s%s%s", flags & RWF_HIPRI ? "|hipri" : "", flags & RWF_NOWAIT ? "|nowait" : "",
+             flags & RWF_DSYNC ? "|dsync" : "");
+    if (buf[0]) {
+        memmove(buf, buf + 1, strlen(buf));
+    } else {
+        snprintf(buf, len, "-");
+    }
+}
+
+int parse_rwf(const char* spec) {
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", spec);
+    int flags = 0;
+    for (char* save = NULL, *name = strtok_r(copy, ",|", &save); name; name = strtok_r(NULL, ",|", &save)) {
+        if (strcmp(name, "hipri") == 0) flags |= RWF_HIPRI;
+        else if (strcmp(name, "nowait") == 0) flags |= RWF_NOWAIT;
+        else if (strcmp(name, "dsync") == 0) flags |= RWF_DSYNC;
+        else {
+            fprintf(stderr, "Error: Unknown RWF flag '%s' (expected hipri, nowait or dsync)\n", name);
+            exit(1);
+        }
+    }
+    return flags;
+}
+
+// How the io_uring engine submits and completes I/Os
+const char* uring_mode_name(benchmark_config* config) {
+    if (config->engine != ENGINE_IO_URING) return "-";
+    if (config->sqpoll && config->iopoll) return "sqpoll+iopoll";
+    if (config->sqpoll) return "sqpoll";
+    if (config->iopoll) return "iopoll";
+    return "interrupt";
+}
+
+const char* arrival_name(arrival_process arrival) {
+    return arrival == ARRIVAL_POISSON ? "poisson" : "fixed";
+}
+
+arrival_process parse_arrival(const char* name) {
+    if (strcmp(name, "fixed") == 0) return ARRIVAL_FIXED;
+    if (strcmp(name, "poisson") == 0) return ARRIVAL_POISSON;
+    fprintf(stderr, "Error: Unknown arrival process '%s'\n", name);
+    exit(1);
+}
+
+io_engine parse_engine(const char* name) {
+    if (strcmp(name, "sync") == 0) return ENGINE_SYNC;
+    if (strcmp(name, "io_uring") == 0) return ENGINE_IO_URING;
+    if (strcmp(name, "libaio") == 0) return ENGINE_LIBAIO;
+    if (strcmp(name, "pvsync2") == 0) return ENGINE_PVSYNC2;
+    if (strcmp(name, "lseek") == 0) return ENGINE_LSEEK;
+    if (strcmp(name, "threadpool") == 0) return ENGINE_THREADPOOL;
+    fprintf(stderr, "Error: Unknown engine '%s'\n", name);
+    exit(1);
+}
+
+// Returns the offset of the next I/O and advances the sequential/stride cursor
+long next_offset(worker* w) {
+    benchmark_config* config = w->config;
+    if (config->is_random && config->dist == DIST_PERMUTE) {
+        // Workers interleave over one shared permutation, so together they hit each slot once per pass
+        if (w->perm_index >= w->perm.num_slots) {
+            w->perm_pass++;
+            w->perm_index = w->id;
+            perm_init(&w->perm, w->perm.num_slots, w->perm_key + w->perm_pass);
+        }
+        uint64_t slot = perm_apply(&w->perm, w->perm_index);
+        w->perm_index += config->num_threads;
+        return w->base + (long)slot * config->io_size;
+    }
+
+    if (config->is_random && config->dist != DIST_UNIFORM) {
+        // Skewed ranks are scattered through the run's shared permutation so the hot set is not
+        // just the start of the range, yet every worker agrees on which slots are hot
+        uint64_t num_slots = w->perm.num_slots;
+        uint64_t rank;
+        switch (config->dist) {
+            case DIST_ZIPF:
+                rank = zipf_next(&w->zipf, &w->rng);
+                break;
+            case DIST_PARETO:
+                rank = pareto_next(config->pareto_h, num_slots, &w->rng);
+                break;
+            case DIST_HOTCOLD:
+            default: {
+                uint64_t hot_slots = (uint64_t)(num_slots * config->hot_range_pct / 100);
+                if (hot_slots < 1) hot_slots = 1;
+                if (hot_slots >= num_slots || rng_double(&w->rng) * 100 < config->hot_io_pct) {
+                    rank = rng_bounded(&w->rng, hot_slots);
+                } else {
+                    rank = hot_slots + rng_bounded(&w->rng, num_slots - hot_slots);
+                }
+                break;
+            }
+        }
+        return w->base + (long)perm_apply(&w->perm, rank) * config->io_size;
+    }
+
+    if (config->is_random) {
+        // Every 4K-aligned position where a full I/O still fits is a candidate
+        uint64_t num_blocks = (w->range - config->io_size) / 4096 + 1;
+        return w->base + (long)rng_bounded(&w->rng, num_blocks) * 4096;
+    }
+
+    long pos = w->current_pos;
+    w->current_pos += config->io_size + config->stride_size;
+    if (w->current_pos + config->io_size > w->range) {
+        w->current_pos = 0;
+    }
+    return w->base + pos;
+}
+
+void format_dist(benchmark_config* config, char* buf, size_t len) {
+    if (!config->is_random) {
+        snprintf(buf, len, "none");
+        return;
+    }
+    switch (config->dist) {
+        case DIST_PERMUTE: snprintf(buf, len, "permute"); break;
+        case DIST_ZIPF: snprintf(buf, len, "zipf:%g", config->zipf_theta); break;
+        case DIST_PARETO: snprintf(buf, len, "pareto:%g", config->pareto_h); break;
+        case DIST_HOTCOLD: snprintf(buf, len, "hotcold:%g:%g", config->hot_io_pct, config->hot_range_pct); break;
+        case DIST_UNIFORM:
+        default: snprintf(buf, len, "uniform"); break;
+    }
+}
+
+// Accepts uniform, permute, zipf[:theta], pareto[:h] and hotcold[:io_pct[:range_pct]]
+void parse_dist(benchmark_config* config, const char* spec) {
+    char name[32];
+    size_t name_len = strcspn(spec, ":");
+    const char* params = spec[name_len] == ':' ? spec + name_len + 1 : NULL;
+    if (name_len >= sizeof(name)) name_len = sizeof(name) - 1;
+    memcpy(name, spec, name_len);
+    name[name_len] = '\0';
+
+    if (strcmp(name, "uniform") == 0) {
+        config->dist = DIST_UNIFORM;
+    } else if (strcmp(name, "permute") == 0) {
+        config->dist = DIST_PERMUTE;
+    } else if (strcmp(name, "zipf") == 0) {
+        config->dist = DIST_ZIPF;
+        if (params) config->zipf_theta = atof(params);
+    } else if (strcmp(name, "pareto") == 0) {
+        config->dist = DIST_PARETO;
+        if (params) config->pareto_h = atof(params);
+    } else if (strcmp(name, "hotcold") == 0) {
+        config->dist = DIST_HOTCOLD;
+        if (params) sscanf(params, "%lf:%lf", &config->hot_io_pct, &config->hot_range_pct);
+    } else {
+        fprintf(stderr, "Error: Unknown distribution '%s'\n", spec);
+        exit(1);
+    }
+    config->is_random = 1;
+}
+
+int config_writes(benchmark_config* config) {
+    if (config->precondition_passes > 0) {
+        return 1;
+    }
+    if (config->rwmix_read >= 0) {
+        return config->rwmix_read < 100;
+    }
+    return config->is_write;
+}
+
+const char* operation_name(benchmark_config* config) {
+    if (config->rwmix_read >= 0) {
+        return "mixed";
+    }
+    return config->is_write ? "write" : "read";
+}
+
+// Picks the direction of the next I/O; --rwmix draws it per I/O from the worker's RNG
+static inline int next_is_write(worker* w) {
+    benchmark_config* config = w->config;
+    if (config->rwmix_read < 0) {
+        return config->is_write;
+    }
+    return rng_bounded(&w->rng, 100) >= (uint64_t)config->rwmix_read;
+}
+
+// Whether the worker may issue another I/O sent (or, with --rate, due) at issued. Ramp-up I/Os
+// are always allowed and free; after that the --runtime deadline or the worker's share of the -m
+// I/O count decides
+static inline int worker_claim_io(worker* w, uint64_t issued) {
+    // An overloaded open-loop schedule falls behind the clock, and its backlog must not stretch
+    // --runtime, which is wall-clock time
+    if (w->deadline_ns && w->config->rate > 0 && get_time_ns() >= w->deadline_ns) {
+        return 0;
+    }
+    if (issued < w->measure_start_ns) {
+        return 1;
+    }
+    if (w->deadline_ns) {
+        return issued < w->deadline_ns;
+    }
+    if (w->claimed_ios >= w->num_ios) {
+        return 0;
+    }
+    w->claimed_ios++;
+    return 1;
+}
+
+// Open-loop schedule: returns when the next I/O is due and draws the gap to the one after.
+// Latency is measured from this intended time, so a stalled device cannot hide its backlog
+static inline uint64_t worker_next_send(worker* w) {
+    uint64_t due = (uint64_t)w->next_send_ns;
+    double gap = w->mean_gap_ns;
+    if (w->config->arrival == ARRIVAL_POISSON) {
+        gap *= -log(1 - rng_double(&w->rng));
+    }
+    w->next_send_ns += gap;
+    return due;
+}
+
+// Sleeps until the given CLOCK_MONOTONIC time, spinning through the last RATE_SPIN_NS
+void sleep_until_ns(uint64_t target) {
+    if (target > get_time_ns() + RATE_SPIN_NS) {
+        struct timespec ts = {(target - RATE_SPIN_NS) / BILLION, (target - RATE_SPIN_NS) % BILLION};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+    }
+    while (get_time_ns() < target) {
+    }
+}
+
+// Completions to wait for per syscall: the --batch-complete count, but never more than are in flight
+static inline int batch_wait_count(benchmark_config* config, int in_flight) {
+    return config->batch_complete < in_flight ? config->batch_complete : in_flight;
+}
+
+// How long an open-loop worker may block on completions before its next send is due; 0 blocks
+// until one arrives, which is all there is to do when no slot is free or no more I/Os will be sent
+uint64_t rate_wait_ns(worker* w, int can_send) {
+    if (w->config->rate == 0 || !can_send) {
+        return 0;
+    }
+    uint64_t now = get_time_ns();
+    return w->next_send_ns > now ? (uint64_t)w->next_send_ns - now : 1;
+}
+
+static inline void live_add(_Atomic uint64_t* counter, uint64_t delta) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + delta,
+                          memory_order_relaxed);
+}
+
+static inline void worker_complete_io(worker* w, int is_write, uint64_t issued_ns, uint64_t now) {
+    w->completed_ios++;
+    // The time series also covers the ramp-up, which is often where the interesting behavior is
+    if (w->live) {
+        live_add(&w->live->ios[is_write], 1);
+        live_add(&w->live->bytes[is_write], w->config->io_size);
+        live_add(&w->live->latency[hist_index(now - issued_ns)], 1);
+    }
+    if (now < w->measure_start_ns) {
+        return;
+    }
+    hist_record(&w->latency[is_write], now - issued_ns);
+    w->bytes[is_write] += w->config->io_size;
+}
+
+void write_csv_header(FILE* fp) {
+    fprintf(fp, "operation,io_size,stride_size,is_random,iteration,throughput,mean,stddev,ci95,engine,queue_depth,threads,"
+                "lat_min_us,lat_mean_us,lat_p50_us,lat_p90_us,lat_p99_us,lat_p99_9_us,lat_p99_99_us,lat_max_us,distribution,"
+                "rwmix_read,read_throughput,read_lat_mean_us,read_lat_p50_us,read_lat_p99_us,read_lat_p99_9_us,"
+                "write_throughput,write_lat_mean_us,write_lat_p50_us,write_lat_p99_us,write_lat_p99_9_us,median,mad,target_ci,converged,"
+                "steady_rounds,steady_state,rate,arrival,iops,hugepages,fixed,cpu_cores,iops_per_core,"
+                "uring_mode,sqpoll_cpu,batch_submit,batch_complete,syscalls_per_io,iovecs,rwf,ctx_switches_per_io\n");
+}
+
+void write_csv_result(FILE* fp, benchmark_config* config, int iteration,
+                      const throughput_stats* stats, int converged, const steady_state* steady,
+                      const run_result* result) {
+    const latency_histogram* latency = &result->latency;
+    const latency_histogram* read_lat = &result->dir_latency[DIR_READ];
+    const latency_histogram* write_lat = &result->dir_latency[DIR_WRITE];
+    int rwmix_read = config->rwmix_read >= 0 ? config->rwmix_read : (config->is_write ? 0 : 100);
+    char dist[64];
+    format_dist(config, dist, sizeof(dist));
+    char rwf[32];
+    format_rwf(config->rwf_flags, rwf, sizeof(rwf));
+    fprintf(fp, "%s,%ld,%ld,%s,%d,%.2f,%.2f,%.2f,%.2f,%s,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%s,"
+                "%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%g,%d,%d,%d,%g,%s,%.0f,%d,%d,%.2f,%.0f,%s,%d,%d,%d,%.3f,%d,%s,%.3f\n",
+            operation_name(config),
+            config->io_size,
+            config->stride_size,
+            config->is_random ? "true" : "false",
+            iteration,
+            result->throughput,
+            stats->mean,
+            stats->stddev,
+            stats->ci95,
+            engine_name(config->engine),
+            config->queue_depth,
+            config->num_threads,
+            (latency->total ? latency->min : 0) / 1e3,
+            hist_mean(latency) / 1e3,
+            hist_percentile(latency, 50) / 1e3,
+            hist_percentile(latency, 90) / 1e3,
+            hist_percentile(latency, 99) / 1e3,
+            hist_percentile(latency, 99.9) / 1e3,
+            hist_percentile(latency, 99.99) / 1e3,
+            latency->max / 1e3,
+            dist,
+            rwmix_read,
+            result->dir_throughput[DIR_READ],
+            hist_mean(read_lat) / 1e3,
+            hist_percentile(read_lat, 50) / 1e3,
+            hist_percentile(read_lat, 99) / 1e3,
+            hist_percentile(read_lat, 99.9) / 1e3,
+            result->dir_throughput[DIR_WRITE],
+            hist_mean(write_lat) / 1e3,
+            hist_percentile(write_lat, 50) / 1e3,
+            hist_percentile(write_lat, 99) / 1e3,
+            hist_percentile(write_lat, 99.9) / 1e3,
+            stats->median,
+            stats->mad,
+            config->target_ci,
+            converged,
+            steady->rounds,
+            steady->reached,
+            config->rate,
+            arrival_name(config->arrival),
+            result->throughput * MB / config->io_size,
+            config->hugepages,
+            config->fixed,
+            result->cpu_cores,
+            result->iops_per_core,
+            uring_mode_name(config),
+            config->sqpoll ? config->sqpoll_cpu : -1,
+            config->batch_submit,
+            config->batch_complete,
+            result->syscalls_per_io,
+            config->num_iovecs,
+            rwf,
+            result->ctx_switches_per_io);
+}
+
+void run_sync(worker* w) {
+    benchmark_config* config = w->config;
+    int fd = w->fd;
+    char* buffer = w->buffers;
+
+    for (;;) {
+        uint64_t issued = config->rate > 0 ? worker_next_send(w) : get_time_ns();
+        if (!worker_claim_io(w, issued)) {
+            break;
+        }
+        if (config->rate > 0) {
+            sleep_until_ns(issued);
+        }
+        long offset = next_offset(w);
+        int is_write = next_is_write(w);
+
+        ssize_t bytes;
+        if (config->engine == ENGINE_LSEEK) {
+            w->syscalls += 2;
+            if (lseek(fd, offset, SEEK_SET) < 0) {
+                perror("lseek failed");
+                exit(1);
+            }
+            if (is_write) {
+                bytes = write(fd, buffer, config->io_size);
+            } else {
+                bytes = read(fd, buffer, config->io_size);
+            }
+        } else {
+            w->syscalls++;
+            if (is_write) {
+                bytes = pwrite(fd, buffer, config->io_size, offset);
+            } else {
+                bytes = pread(fd, buffer, config->io_size, offset);
+            }
+        }
+
+        if (bytes != config->io_size) {
+            fprintf(stderr, "I/O operation failed: expected %ld bytes, got %zd bytes\n", config->io_size, bytes);
+            exit(1);
+        }
+
+        uint64_t now = get_time_ns();
+        worker_complete_io(w, is_write, issued, now);
+    }
+}
+
+// Lays the iovecs out back to back in the worker's buffer, split evenly in 4K units unless
+// explicit sizes were given
+void iovec_layout(benchmark_config* config, char* buffer, struct iovec* iov) {
+    long pages = config->io_size / 4096;
+    for (int i = 0; i < config->num_iovecs; i++) {
+        iov[i].iov_base = buffer;
+        iov[i].iov_len = config->iovec_sizes ? config->iovec_sizes[i]
+                                             : (pages / config->num_iovecs + (i < pages % config->num_iovecs)) * 4096;
+        buffer += iov[i].iov_len;
+    }
+}
+
+// Positional vectored I/O: one preadv2/pwritev2 per operation, with the offset in the call
+void run_pvsync2(worker* w) {
+    benchmark_config* config = w->config;
+    int fd = w->fd;
+    int count = config->num_iovecs;
+    struct iovec iov[count];
+    iovec_layout(config, w->buffers, iov);
+
+    for (;;) {
+        uint64_t issued = config->rate > 0 ? worker_next_send(w) : get_time_ns();
+        if (!worker_claim_io(w, issued)) {
+            break;
+        }
+        if (config->rate > 0) {
+            sleep_until_ns(issued);
+        }
+        long offset = next_offset(w);
+        int is_write = next_is_write(w);
+
+        // RWF_NOWAIT turns an I/O that would block into EAGAIN; retrying shows up in syscalls per I/O
+        ssize_t bytes;
+        do {
+            w->syscalls++;
+            if (is_write) {
+                bytes = pwritev2(fd, iov, count, offset, config->rwf_flags);
+            } else {
+                bytes = preadv2(fd, iov, count, offset, config->rwf_flags);
+            }
+        } while (bytes < 0 && (errno == EAGAIN || errno == EINTR));
+
+        if (bytes != config->io_size) {
+            fprintf(stderr, "I/O operation failed: expected %ld bytes, got %zd bytes (%s)\n", config->io_size, bytes,
+                    bytes < 0 ? strerror(errno) : "short I/O");
+            exit(1);
+        }
+
+        uint64_t now = get_time_ns();
+        worker_complete_io(w, is_write, issued, now);
+    }
+}
+
+// One I/O handed from the threadpool producer to a worker
+typedef struct {
+    long offset;
+    int is_write;
+    uint64_t issued_ns;
+} io_request;
+
+typedef struct {
+    _Atomic size_t sequence;  // Whose turn the cell is: position for a producer, position + 1 for a consumer
+    io_request req;
+} queue_cell;
+
+// Futex-backed wakeup: waiters sleep until the next signal, and signalling costs no syscall
+// while nobody waits
+typedef struct {
+    _Atomic uint32_t seq;
+    _Atomic int waiters;
+} queue_event;
+
+// Bounded lock-free MPMC ring (Vyukov). Each cursor sits on its own cache line so the producer
+// and the workers do not bounce one line between them on every request
+typedef struct request_queue {
+    queue_cell* cells;
+    size_t mask;
+    _Alignas(64) _Atomic size_t enqueue_pos;
+    _Alignas(64) _Atomic size_t dequeue_pos;
+    _Alignas(64) queue_event not_empty;
+    queue_event not_full;
+    _Atomic int closed;  // Set by the producer once it has pushed its last request
+} request_queue;
+
+// Capacity is depth rounded up to a power of two, so a position maps to its cell with a mask.
+// The cell sequences need at least two cells to tell a full lap from an empty one
+void queue_init(request_queue* q, int depth) {
+    size_t capacity = 2;
+    while (capacity < (size_t)depth) {
+        capacity <<= 1;
+    }
+    q->cells = calloc(capacity, sizeof(queue_cell));
+    if (!q->cells) {
+        perror("Failed to allocate request queue");
+        exit(1);
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&q->cells[i].sequence, i);
+    }
+    q->mask = capacity - 1;
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+    atomic_init(&q->not_empty.seq, 0);
+    atomic_init(&q->not_empty.waiters, 0);
+    atomic_init(&q->not_full.seq, 0);
+    atomic_init(&q->not_full.waiters, 0);
+    atomic_init(&q->closed, 0);
+}
+
+int queue_push(request_queue* q, const io_request* req) {
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        queue_cell* cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->req = *req;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;  // Full: the cell still holds a request from the previous lap
+        } else {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+int queue_pop(request_queue* q, io_request* req) {
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        queue_cell* cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *req = cell->req;
+                atomic_store_explicit(&cell->sequence, pos + q->mask + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;  // Empty
+        } else {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Registers a waiter and returns the value to sleep on. Registering before the caller's last
+// check of its condition means a signal sent after that check is never missed
+uint32_t event_prepare(queue_event* ev) {
+    uint32_t seq = atomic_load(&ev->seq);
+    atomic_fetch_add(&ev->waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    return seq;
+}
+
+void event_wait(queue_event* ev, uint32_t seq, long* syscalls) {
+    (*syscalls)++;
+    syscall(__NR_futex, &ev->seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+}
+
+void event_done(queue_event* ev) {
+    atomic_fetch_sub(&ev->waiters, 1);
+}
+
+// The fence orders the caller's queue update before the waiter check, pairing with event_prepare
+void event_signal(queue_event* ev, int all, long* syscalls) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (all || atomic_load_explicit(&ev->waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&ev->seq, 1);
+        (*syscalls)++;
+        syscall(__NR_futex, &ev->seq, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, NULL, NULL, 0);
+    }
+}
+
+// Blocks while the queue is full. Closed-loop requests are stamped each time they try for a
+// slot, so their latency covers queueing behind the workers but not the producer's own wait
+void queue_put(request_queue* q, io_request* req, int restamp, long* syscalls) {
+    for (int spins = 0;; spins++) {
+        if (restamp) {
+            req->issued_ns = get_time_ns();
+        }
+        if (queue_push(q, req)) {
+            break;
+        }
+        if (spins < QUEUE_SPINS) {
+            continue;
+        }
+        uint32_t seq = event_prepare(&q->not_full);
+        int pushed = queue_push(q, req);
+        if (!pushed) {
+            event_wait(&q->not_full, seq, syscalls);
+        }
+        event_done(&q->not_full);
+        if (pushed) {
+            break;
+        }
+    }
+    event_signal(&q->not_empty, 0, syscalls);
+}
+
+// Blocks until a request is available; returns 0 once the queue is closed and drained
+int queue_get(request_queue* q, io_request* req, long* syscalls) {
+    for (int spins = 0;; spins++) {
+        if (queue_pop(q, req)) {
+            break;
+        }
+        if (atomic_load(&q->closed)) {
+            // Everything pushed before the close is visible now, so one more miss means drained
+            if (!queue_pop(q, req)) {
+                return 0;
+            }
+            break;
+        }
+        if (spins < QUEUE_SPINS) {
+            continue;
+        }
+        uint32_t seq = event_prepare(&q->not_empty);
+        int popped = queue_pop(q, req);
+        if (!popped && !atomic_load(&q->closed)) {
+            event_wait(&q->not_empty, seq, syscalls);
+        }
+        event_done(&q->not_empty);
+        if (popped) {
+            break;
+        }
+    }
+    event_signal(&q->not_full, 0, syscalls);
+    return 1;
+}
+
+// Generates every offset of the run, as a single sync thread would, and queues them for the
+// workers. -q sizes the ring, which holds only requests not yet picked up, so up to its
+// capacity plus -j I/Os are outstanding at once
+void run_producer(worker* w) {
+    benchmark_config* config = w->config;
+    request_queue* q = w->queue;
+
+    for (;;) {
+        uint64_t issued = config->rate > 0 ? worker_next_send(w) : get_time_ns();
+        if (!worker_claim_io(w, issued)) {
+            break;
+        }
+        if (config->rate > 0) {
+            sleep_until_ns(issued);
+        }
+        io_request req = {next_offset(w), next_is_write(w), issued};
+        queue_put(q, &req, config->rate == 0, &w->syscalls);
+    }
+
+    atomic_store(&q->closed, 1);
+    event_signal(&q->not_empty, 1, &w->syscalls);
+}
+
+// A blocking pool thread: pread/pwrite whatever the producer queued until it closes the queue
+void run_threadpool(worker* w) {
+    benchmark_config* config = w->config;
+    int fd = w->fd;
+    char* buffer = w->buffers;
+    io_request req;
+
+    while (queue_get(w->queue, &req, &w->syscalls)) {
+        ssize_t bytes;
+        w->syscalls++;
+        if (req.is_write) {
+            bytes = pwrite(fd, buffer, config->io_size, req.offset);
+        } else {
+            bytes = pread(fd, buffer, config->io_size, req.offset);
+        }
+
+        if (bytes != config->io_size) {
+            fprintf(stderr, "I/O operation failed: expected %ld bytes, got %zd bytes\n", config->io_size, bytes);
+            exit(1);
+        }
+
+        uint64_t now = get_time_ns();
+        worker_complete_io(w, req.is_write, req.issued_ns, now);
+    }
+}
+
+// Minimal io_uring ring driven through the raw syscalls so no liburing is needed
+typedef struct {
+    int ring_fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* sq_flags;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ptr;
+    size_t sq_len;
+    void* cq_ptr;
+    size_t cq_len;
+    size_t sqes_len;
+    unsigned sqe_tail;  // Tail including SQEs prepared but not yet published to the kernel
+    int sqpoll;
+    long enters;  // io_uring_enter calls made
+} uring;
+
+// setup_flags takes IORING_SETUP_SQPOLL and IORING_SETUP_IOPOLL; sq_cpu >= 0 pins the SQPOLL thread
+void uring_setup(uring* ring, unsigned entries, unsigned setup_flags, int sq_cpu) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = setup_flags;
+    if (setup_flags & IORING_SETUP_SQPOLL) {
+        params.sq_thread_idle = SQPOLL_IDLE_MS;
+        if (sq_cpu >= 0) {
+            params.flags |= IORING_SETUP_SQ_AFF;
+            params.sq_thread_cpu = sq_cpu;
+        }
+    }
+    ring->sqpoll = (setup_flags & IORING_SETUP_SQPOLL) != 0;
+    ring->enters = 0;
+
+    ring->ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->ring_fd < 0) {
+        perror("io_uring_setup failed");
+        exit(1);
+    }
+
+    ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len) ring->sq_len = ring->cq_len;
+        ring->cq_len = ring->sq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        perror("io_uring sq ring mmap failed");
+        exit(1);
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            perror("io_uring cq ring mmap failed");
+            exit(1);
+        }
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        perror("io_uring sqes mmap failed");
+        exit(1);
+    }
+
+    char* sq = ring->sq_ptr;
+    char* cq = ring->cq_ptr;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->sq_flags = (unsigned*)(sq + params.sq_off.flags);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring->sqe_tail = *ring->sq_tail;
+}
+
+void uring_teardown(uring* ring) {
+    munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_len);
+    }
+    munmap(ring->sq_ptr, ring->sq_len);
+    close(ring->ring_fd);
+}
+
+void uring_register(uring* ring, unsigned opcode, void* arg, unsigned nr_args) {
+    if (syscall(__NR_io_uring_register, ring->ring_fd, opcode, arg, nr_args) < 0) {
+        perror("io_uring_register failed");
+        exit(1);
+    }
+}
+
+// Caller must never have more SQEs outstanding than the ring holds. The SQE stays private to
+// the caller until uring_publish(), so it can be filled in before the kernel may look at it
+struct io_uring_sqe* uring_get_sqe(uring* ring) {
+    unsigned index = ring->sqe_tail++ & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+// Hands every prepared SQE to the kernel at once. The release store orders the SQE contents
+// before the tail, which a SQPOLL thread may read at any moment
+void uring_publish(uring* ring) {
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+}
+
+// A nonzero timeout_ns bounds the wait for min_complete completions
+int uring_enter(uring* ring, unsigned to_submit, unsigned min_complete, uint64_t timeout_ns) {
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts = {timeout_ns / BILLION, timeout_ns % BILLION};
+    struct io_uring_getevents_arg arg = {.ts = (unsigned long)&ts};
+    void* argp = NULL;
+    size_t argsz = 0;
+    if (timeout_ns && min_complete > 0) {
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+    if (ring->sqpoll) {
+        // The kernel thread picks up new SQEs by itself and only needs a syscall once it has
+        // gone to sleep; the fence orders the tail store before the flags load
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        }
+        if (!(flags & (IORING_ENTER_GETEVENTS | IORING_ENTER_SQ_WAKEUP))) {
+            return to_submit;
+        }
+    }
+    int ret;
+    do {
+        ring->enters++;
+        ret = syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, min_complete, flags, argp, argsz);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0 && errno == ETIME) {
+        return 0;
+    }
+    if (ret < 0) {
+        perror("io_uring_enter failed");
+        exit(1);
+    }
+    return ret;
+}
+
+void run_io_uring(worker* w) {
+    benchmark_config* config = w->config;
+    int fd = w->fd;
+    char* buffers = w->buffers;
+    uring ring;
+    int depth = config->queue_depth;
+    int free_slots[depth];
+    uint64_t issued_ns[depth];
+    unsigned char slot_is_write[depth];
+    int num_free = depth;
+
+    unsigned setup_flags = (config->sqpoll ? IORING_SETUP_SQPOLL : 0) | (config->iopoll ? IORING_SETUP_IOPOLL : 0);
+    uring_setup(&ring, depth, setup_flags, config->sqpoll_cpu);
+    for (int i = 0; i < depth; i++) {
+        free_slots[i] = i;
+    }
+    // Registering pins each slot's buffer and takes the fd reference once for the whole run,
+    // instead of on every I/O
+    if (config->fixed) {
+        struct iovec iovecs[depth];
+        for (int i = 0; i < depth; i++) {
+            iovecs[i].iov_base = buffers + (long)i * config->io_size;
+            iovecs[i].iov_len = config->io_size;
+        }
+        uring_register(&ring, IORING_REGISTER_BUFFERS, iovecs, depth);
+        uring_register(&ring, IORING_REGISTER_FILES, &fd, 1);
+    }
+
+    int done = 0;
+    for (;;) {
+        unsigned to_submit = 0;
+        uint64_t now = get_time_ns();
+        while (num_free > 0 && !done && (config->rate == 0 || w->next_send_ns <= now)) {
+            uint64_t issued = config->rate > 0 ? worker_next_send(w) : now;
+            if (!worker_claim_io(w, issued)) {
+                done = 1;
+                break;
+            }
+            int slot = free_slots[--num_free];
+            issued_ns[slot] = issued;
+            slot_is_write[slot] = next_is_write(w);
+            struct io_uring_sqe* sqe = uring_get_sqe(&ring);
+            if (config->fixed) {
+                sqe->opcode = slot_is_write[slot] ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                sqe->fd = 0;  // Index into the registered files
+                sqe->flags = IOSQE_FIXED_FILE;
+                sqe->buf_index = slot;
+            } else {
+                sqe->opcode = slot_is_write[slot] ? IORING_OP_WRITE : IORING_OP_READ;
+                sqe->fd = fd;
+            }
+            sqe->off = next_offset(w);
+            sqe->addr = (unsigned long)(buffers + (long)slot * config->io_size);
+            sqe->len = config->io_size;
+            sqe->user_data = slot;
+            to_submit++;
+        }
+        if (to_submit > 0) {
+            uring_publish(&ring);
+        }
+
+        // Out of work and nothing left in flight
+        if (num_free == depth) {
+            if (done) {
+                break;
+            }
+            sleep_until_ns((uint64_t)w->next_send_ns);
+            continue;
+        }
+
+        // Only the last submission of a split batch also waits for completions
+        while (config->batch_submit > 0 && to_submit > (unsigned)config->batch_submit) {
+            uring_enter(&ring, config->batch_submit, 0, 0);
+            to_submit -= config->batch_submit;
+        }
+        uring_enter(&ring, to_submit, batch_wait_count(config, depth - num_free),
+                    rate_wait_ns(w, num_free > 0 && !done));
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        now = get_time_ns();
+        while (head != tail) {
+            struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+            if (cqe->res == -EOPNOTSUPP && config->iopoll) {
+                fprintf(stderr, "Error: %s does not support polled I/O (--iopoll)\n", config->device);
+                exit(1);
+            }
+            if (cqe->res != config->io_size) {
+                fprintf(stderr, "I/O operation failed: expected %ld bytes, got %d (%s)\n",
+                        config->io_size, cqe->res, cqe->res < 0 ? strerror(-cqe->res) : "short I/O");
+                exit(1);
+            }
+            int slot = (int)cqe->user_data;
+            worker_complete_io(w, slot_is_write[slot], issued_ns[slot], now);
+            free_slots[num_free++] = slot;
+            head++;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    w->syscalls += ring.enters;
+    uring_teardown(&ring);
+}
+
+// Linux native AIO, also through raw syscalls so libaio itself is not required
+void run_libaio(worker* w) {
+    benchmark_config* config = w->config;
+    int fd = w->fd;
+    char* buffers = w->buffers;
+    aio_context_t ctx = 0;
+    int depth = config->queue_depth;
+    struct iocb iocbs[depth];
+    struct iocb* pending[depth];
+    struct io_event events[depth];
+    int free_slots[depth];
+    uint64_t issued_ns[depth];
+    unsigned char slot_is_write[depth];
+    int num_free = depth;
+
+    if (syscall(__NR_io_setup, depth, &ctx) < 0) {
+        perror("io_setup failed");
+        exit(1);
+    }
+    for (int i = 0; i < depth; i++) {
+        free_slots[i] = i;
+    }
+
+    int done = 0;
+    for (;;) {
+        int to_submit = 0;
+        uint64_t now = get_time_ns();
+        while (num_free > 0 && !done && (config->rate == 0 || w->next_send_ns <= now)) {
+            uint64_t issued = config->rate > 0 ? worker_next_send(w) : now;
+            if (!worker_claim_io(w, issued)) {
+                done = 1;
+                break;
+            }
+            int slot = free_slots[--num_free];
+            issued_ns[slot] = issued;
+            slot_is_write[slot] = next_is_write(w);
+            struct iocb* cb = &iocbs[slot];
+            memset(cb, 0, sizeof(*cb));
+            cb->aio_lio_opcode = slot_is_write[slot] ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD;
+            cb->aio_fildes = fd;
+            cb->aio_offset = next_offset(w);
+            cb->aio_buf = (unsigned long)(buffers + (long)slot * config->io_size);
+            cb->aio_nbytes = config->io_size;
+            cb->aio_data = slot;
+            pending[to_submit++] = cb;
+        }
+
+        // Out of work and nothing left in flight
+        if (num_free == depth) {
+            if (done) {
+                break;
+            }
+            sleep_until_ns((uint64_t)w->next_send_ns);
+            continue;
+        }
+
+        // Submit the whole batch in as few io_submit calls as the kernel and --batch-submit allow
+        int submitted = 0;
+        while (submitted < to_submit) {
+            int chunk = to_submit - submitted;
+            if (config->batch_submit > 0 && chunk > config->batch_submit) {
+                chunk = config->batch_submit;
+            }
+            w->syscalls++;
+            long ret = syscall(__NR_io_submit, ctx, chunk, pending + submitted);
+            if (ret < 0 && errno == EINTR) continue;
+            if (ret <= 0) {
+                perror("io_submit failed");
+                exit(1);
+            }
+            submitted += ret;
+        }
+
+        uint64_t wait_ns = rate_wait_ns(w, num_free > 0 && !done);
+        struct timespec timeout = {wait_ns / BILLION, wait_ns % BILLION};
+        long reaped;
+        do {
+            w->syscalls++;
+            reaped = syscall(__NR_io_getevents, ctx, batch_wait_count(config, depth - num_free), depth, events,
+                             wait_ns ? &timeout : NULL);
+        } while (reaped < 0 && errno == EINTR);
+        if (reaped < 0) {
+            perror("io_getevents failed");
+            exit(1);
+        }
+
+        now = get_time_ns();
+        for (long i = 0; i < reaped; i++) {
+            if (events[i].res != config->io_size) {
+                fprintf(stderr, "I/O operation failed: expected %ld bytes, got %lld (%s)\n",
+                        config->io_size, (long long)events[i].res,
+                        events[i].res < 0 ? strerror(-events[i].res) : "short I/O");
+                exit(1);
+            }
+            int slot = (int)events[i].data;
+            worker_complete_io(w, slot_is_write[slot], issued_ns[slot], now);
+            free_slots[num_free++] = slot;
+        }
+    }
+
+    syscall(__NR_io_destroy, ctx);
+}
+
+// Waits for every thread of the run, then sets up the worker's ramp-up, deadline and rate schedule
+void worker_begin(worker* w) {
+    benchmark_config* config = w->config;
+
+    pthread_barrier_wait(w->barrier);
+    uint64_t start_ns = get_time_ns();
+    w->measure_start_ns = config->ramp > 0 ? start_ns + (uint64_t)(config->ramp * BILLION) : 0;
+    if (config->runtime > 0) {
+        w->deadline_ns = (w->measure_start_ns ? w->measure_start_ns : start_ns) + (uint64_t)(config->runtime * BILLION);
+    }
+    if (config->rate > 0) {
+        w->mean_gap_ns = BILLION * config->num_threads / config->rate;
+        // Staggered starts interleave the workers' schedules instead of sending in bursts of -j
+        w->next_send_ns = start_ns + w->id * w->mean_gap_ns / config->num_threads;
+    }
+    // Throughput is measured from the end of the ramp-up, same clock as get_time()
+    w->start = (w->measure_start_ns ? w->measure_start_ns : start_ns) / 1e9;
+}
+
+void* run_worker(void* arg) {
+    worker* w = arg;
+    benchmark_config* config = w->config;
+
+    worker_begin(w);
+    switch (config->engine) {
+        case ENGINE_IO_URING: run_io_uring(w); break;
+        case ENGINE_LIBAIO: run_libaio(w); break;
+        case ENGINE_PVSYNC2: run_pvsync2(w); break;
+        case ENGINE_THREADPOOL: run_threadpool(w); break;
+        case ENGINE_LSEEK:
+        case ENGINE_SYNC:
+        default: run_sync(w); break;
+    }
+
+    if (config_writes(config)) {
+        fsync(w->fd);
+    }
+
+    w->end = get_time();
+    return NULL;
+}
+
+void* run_producer_thread(void* arg) {
+    worker* w = arg;
+    worker_begin(w);
+    run_producer(w);
+    return NULL;
+}
+
+void write_log_header(FILE* fp) {
+    fprintf(fp, "run,phase,operation,io_size,stride_size,queue_depth,time_s,read_iops,write_iops,"
+                "read_mb_s,write_mb_s,lat_p50_us,lat_p99_us,lat_p99_9_us,lat_max_us\n");
+}
+
+// Writes one time-series row per interval with the difference between successive counter snapshots
+void* run_sampler(void* arg) {
+    sampler* s = arg;
+    benchmark_config* config = s->config;
+    interval_log* series = config->series;
+    uint64_t last_ios[2] = {0, 0}, last_bytes[2] = {0, 0};
+    uint64_t* last_latency = calloc(HIST_BUCKETS, sizeof(uint64_t));
+    latency_histogram* interval = malloc(sizeof(latency_histogram));
+    if (!last_latency || !interval) {
+        perror("Failed to allocate sampler state");
+        exit(1);
+    }
+
+    uint64_t start_ns = get_time_ns(), last_ns = start_ns;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    int stop = 0;
+    while (!stop) {
+        // Absolute deadlines keep the sampling period from drifting
+        deadline.tv_nsec += config->log_interval_ms % 1000 * 1000000L;
+        deadline.tv_sec += config->log_interval_ms / 1000 + deadline.tv_nsec / BILLION;
+        deadline.tv_nsec %= BILLION;
+        pthread_mutex_lock(&s->lock);
+        while (!s->stop && pthread_cond_timedwait(&s->wake, &s->lock, &deadline) != ETIMEDOUT) {
+        }
+        stop = s->stop;
+        pthread_mutex_unlock(&s->lock);
+
+        uint64_t now_ns = get_time_ns();
+        uint64_t delta_ios[2], delta_bytes[2];
+        for (int dir = DIR_READ; dir <= DIR_WRITE; dir++) {
+            uint64_t ios = 0, bytes = 0;
+            for (int i = 0; i < s->num_workers; i++) {
+                ios += atomic_load_explicit(&s->live[i].ios[dir], memory_order_relaxed);
+                bytes += atomic_load_explicit(&s->live[i].bytes[dir], memory_order_relaxed);
+            }
+            delta_ios[dir] = ios - last_ios[dir];
+            delta_bytes[dir] = bytes - last_bytes[dir];
+            last_ios[dir] = ios;
+            last_bytes[dir] = bytes;
+        }
+        hist_reset(interval);
+        for (int b = 0; b < HIST_BUCKETS; b++) {
+            uint64_t count = 0;
+            for (int i = 0; i < s->num_workers; i++) {
+                count += atomic_load_explicit(&s->live[i].latency[b], memory_order_relaxed);
+            }
+            interval->counts[b] = count - last_latency[b];
+            last_latency[b] = count;
+            if (interval->counts[b]) {
+                interval->total += interval->counts[b];
+                interval->max = hist_bucket_value(b);
+            }
+        }
+
+        // The last interval is cut short by the end of the run, and may hold nothing at all
+        double seconds = (now_ns - last_ns) / 1e9;
+        if (seconds <= 0 || (stop && interval->total == 0)) {
+            continue;
+        }
+        fprintf(series->fp, "%d,%s,%s,%ld,%ld,%d,%.3f,%.0f,%.0f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n",
+                series->run, series->phase, operation_name(config), config->io_size, config->stride_size,
+                config->queue_depth, (now_ns - start_ns) / 1e9,
+                delta_ios[DIR_READ] / seconds, delta_ios[DIR_WRITE] / seconds,
+                delta_bytes[DIR_READ] / seconds / MB, delta_bytes[DIR_WRITE] / seconds / MB,
+                hist_percentile(interval, 50) / 1e3, hist_percentile(interval, 99) / 1e3,
+                hist_percentile(interval, 99.9) / 1e3, interval->max / 1e3);
+        last_ns = now_ns;
+    }
+    fflush(series->fp);
+    free(last_latency);
+    free(interval);
+    return NULL;
+}
+
+// Each in-flight I/O needs its own buffer, so async engines get queue_depth of them
+size_t buffer_bytes_needed(benchmark_config* config, long io_size, int queue_depth) {
+    return (size_t)io_size * (engine_is_async(config->engine) ? queue_depth : 1);
+}
+
+void pool_release(buffer_pool* pool) {
+    if (pool->base) {
+        munmap(pool->base, pool->size);
+        pool->base = NULL;
+        pool->size = 0;
+    }
+}
+
+// Maps anonymous memory aligned to 2 MB so transparent huge pages can back all of it
+char* pool_map_thp(size_t size) {
+    char* raw = mmap(NULL, size + HUGE_2MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    char* base = (char*)(((uintptr_t)raw + HUGE_2MB - 1) & ~(uintptr_t)(HUGE_2MB - 1));
+    if (base > raw) {
+        munmap(raw, base - raw);
+    }
+    munmap(base + size, raw + HUGE_2MB - base);
+    madvise(base, size, MADV_HUGEPAGE);
+    return base;
+}
+
+// Makes the pool at least bytes large: 1 GB huge pages when the buffers fill one, then 2 MB
+// huge pages, then 2 MB-aligned memory with a transparent huge page hint
+void pool_reserve(buffer_pool* pool, size_t bytes, int hugepages) {
+    if (pool->size >= bytes) {
+        return;
+    }
+    pool_release(pool);
+
+    size_t size = (bytes + HUGE_2MB - 1) / HUGE_2MB * HUGE_2MB;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE;
+    char* base = MAP_FAILED;
+    if (hugepages && bytes >= HUGE_1GB) {
+        size_t huge = (bytes + HUGE_1GB - 1) / HUGE_1GB * HUGE_1GB;
+        base = mmap(NULL, huge, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+        if (base != MAP_FAILED) {
+            size = huge;
+            pool->backing = "1 GB huge pages";
+        }
+    }
+    if (hugepages && base == MAP_FAILED) {
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+        pool->backing = "2 MB huge pages";
+    }
+    if (base == MAP_FAILED) {
+        base = hugepages ? pool_map_thp(size) : mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (!base || base == MAP_FAILED) {
+            perror("Failed to map I/O buffers");
+            exit(1);
+        }
+        pool->backing = hugepages ? "transparent huge pages (madvise)" : "4 KB pages";
+    }
+    pool->base = base;
+    pool->size = size;
+
+    // Locking also faults everything in up front; without the privilege the pool still works
+    pool->locked = mlock(base, size) == 0;
+    if (!pool->locked) {
+        memset(base, 0, size);
+    }
+}
+
+worker_resources* resources_create(benchmark_config* config, size_t buffer_bytes) {
+    worker_resources* res = calloc(config->num_threads, sizeof(worker_resources));
+    if (!res) {
+        perror("Failed to allocate worker resources");
+        exit(1);
+    }
+
+    // Each worker's slice starts on a 4K boundary, as O_DIRECT requires
+    size_t slice = (buffer_bytes + 4095) / 4096 * 4096;
+    pool_reserve(config->pool, slice * config->num_threads, config->hugepages);
+    printf("Buffers: %zu MB pool on %s%s\n", config->pool->size / MB, config->pool->backing,
+           config->pool->locked ? ", locked" : "");
+
+    int flags = O_DIRECT | (config_writes(config) ? O_RDWR : O_RDONLY);
+    for (int i = 0; i < config->num_threads; i++) {
+        res[i].buffers = config->pool->base + slice * i;
+        if (config->shared_fd && i > 0) {
+            res[i].fd = res[0].fd;
+            continue;
+        }
+        res[i].fd = open(config->device, flags);
+        if (res[i].fd < 0) {
+            perror("Failed to open device");
+            exit(1);
+        }
+    }
+    return res;
+}
+
+void resources_destroy(benchmark_config* config, worker_resources* res) {
+    for (int i = 0; i < (config->shared_fd ? 1 : config->num_threads); i++) {
+        close(res[i].fd);
+    }
+    free(res);
+}
+
+// Gives a worker its own random stream and, for the skewed distributions, the run's permutation
+void worker_seed_offsets(worker* w, uint64_t perm_key) {
+    benchmark_config* config = w->config;
+    rng_seed(&w->rng, splitmix64(&config->next_seed));
+    if (config->is_random && config->dist != DIST_UNIFORM) {
+        // io_size slots so one permuted pass touches every byte of the range exactly once
+        w->perm_key = perm_key;
+        w->perm_index = w->id;
+        perm_init(&w->perm, config->range / config->io_size, perm_key);
+        if (config->dist == DIST_ZIPF) {
+            zipf_init(&w->zipf, w->perm.num_slots, config->zipf_theta);
+        }
+    }
+}
+
+// Fills result with aggregate MB/s and every worker's per-I/O latencies, overall and per direction
+void run_benchmark(benchmark_config* config, worker_resources* res, run_result* result) {
+    int n = config->num_threads;
+    // The threadpool engine adds a producer thread, which generates the offsets for the workers
+    int producers = config->engine == ENGINE_THREADPOOL ? 1 : 0;
+    pthread_t threads[n + producers];
+    pthread_barrier_t barrier;
+
+    validate_config(config);
+
+    // Sequential/stride workers walk disjoint 4K-aligned slices; random workers share the range
+    long slice = config->is_random ? config->range : config->range / n / 4096 * 4096;
+    pthread_barrier_init(&barrier, NULL, n + producers);
+
+    uint64_t perm_key = splitmix64(&config->next_seed);
+
+    // Workers carry their histograms, so keep them off the stack
+    worker* workers = calloc(n + producers, sizeof(worker));
+    live_counters* live = config->series ? calloc(n, sizeof(live_counters)) : NULL;
+    if (!workers || (config->series && !live)) {
+        perror("Failed to allocate workers");
+        exit(1);
+    }
+    request_queue queue;
+    benchmark_config producer_config;
+    if (producers) {
+        queue_init(&queue, config->queue_depth);
+    }
+
+    // Process CPU time covers the workers, the sampler and any io_uring worker threads
+    // Context switches are where a blocking thread pool pays compared to the async engines
+    struct rusage usage_start, usage_end;
+    getrusage(RUSAGE_SELF, &usage_start);
+    double wall_start = get_time();
+
+    pthread_t sampler_thread;
+    sampler s = {.config = config, .live = live, .num_workers = n, .stop = 0};
+    if (config->series) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&s.wake, &attr);
+        pthread_condattr_destroy(&attr);
+        pthread_mutex_init(&s.lock, NULL);
+        config->series->run++;
+        if (pthread_create(&sampler_thread, NULL, run_sampler, &s) != 0) {
+            fprintf(stderr, "Failed to create sampler thread\n");
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        worker* w = &workers[i];
+        hist_reset(&w->latency[DIR_READ]);
+        hist_reset(&w->latency[DIR_WRITE]);
+        w->config = config;
+        w->id = i;
+        w->fd = res[i].fd;
+        w->buffers = res[i].buffers;
+        w->live = live ? &live[i] : NULL;
+        w->base = config->is_random ? 0 : slice * i;
+        w->range = slice;
+        // Split the I/O count so -m stays the total for the whole run
+        w->num_ios = config->io_multiplier / n + (i < config->io_multiplier % n ? 1 : 0);
+        worker_seed_offsets(w, perm_key);
+        w->queue = &queue;
+        w->barrier = &barrier;
+        if (pthread_create(&threads[i], NULL, run_worker, w) != 0) {
+            fprintf(stderr, "Failed to create worker thread %d\n", i);
+            exit(1);
+        }
+    }
+    if (producers) {
+        // The producer alone walks the pattern, over the whole range as a single thread would
+        producer_config = *config;
+        producer_config.num_threads = 1;
+        worker* p = &workers[n];
+        p->config = &producer_config;
+        p->range = config->is_random ? config->range : config->range / 4096 * 4096;
+        p->num_ios = config->io_multiplier;
+        worker_seed_offsets(p, perm_key);
+        config->next_seed = producer_config.next_seed;
+        p->queue = &queue;
+        p->barrier = &barrier;
+        if (pthread_create(&threads[n], NULL, run_producer_thread, p) != 0) {
+            fprintf(stderr, "Failed to create producer thread\n");
+            exit(1);
+        }
+    }
+
+    long bytes[2] = {0, 0};
+    long syscalls = 0, completed_ios = 0;
+    double start = 0, end = 0;
+    hist_reset(&result->dir_latency[DIR_READ]);
+    hist_reset(&result->dir_latency[DIR_WRITE]);
+    for (int i = 0; i < n; i++) {
+        pthread_join(threads[i], NULL);
+        for (int dir = DIR_READ; dir <= DIR_WRITE; dir++) {
+            bytes[dir] += workers[i].bytes[dir];
+            hist_merge(&result->dir_latency[dir], &workers[i].latency[dir]);
+        }
+        syscalls += workers[i].syscalls;
+        completed_ios += workers[i].completed_ios;
+        if (i == 0 || workers[i].start < start) start = workers[i].start;
+        if (i == 0 || workers[i].end > end) end = workers[i].end;
+    }
+    if (producers) {
+        pthread_join(threads[n], NULL);
+        syscalls += workers[n].syscalls;
+        free(queue.cells);
+    }
+    pthread_barrier_destroy(&barrier);
+    free(workers);
+    getrusage(RUSAGE_SELF, &usage_end);
+    double wall = get_time() - wall_start;
+
+    if (config->series) {
+        pthread_mutex_lock(&s.lock);
+        s.stop = 1;
+        pthread_cond_signal(&s.wake);
+        pthread_mutex_unlock(&s.lock);
+        pthread_join(sampler_thread, NULL);
+        pthread_cond_destroy(&s.wake);
+        pthread_mutex_destroy(&s.lock);
+        free(live);
+    }
+
+    hist_reset(&result->latency);
+    hist_merge(&result->latency, &result->dir_latency[DIR_READ]);
+    hist_merge(&result->latency, &result->dir_latency[DIR_WRITE]);
+
+    // Aggregate throughput across all workers over the wall-clock span of the run
+    double elapsed = end - start;
+    result->dir_throughput[DIR_READ] = (double)bytes[DIR_READ] / elapsed / MB;
+    result->dir_throughput[DIR_WRITE] = (double)bytes[DIR_WRITE] / elapsed / MB;
+    result->throughput = result->dir_throughput[DIR_READ] + result->dir_throughput[DIR_WRITE];
+
+    double cpu = (usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec) +
+                 (usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec) / 1e6 +
+                 (usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) +
+                 (usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec) / 1e6;
+    result->cpu_cores = cpu / wall;
+    result->syscalls_per_io = completed_ios ? (double)syscalls / completed_ios : 0;
+    long ctx_switches = (usage_end.ru_nvcsw - usage_start.ru_nvcsw) + (usage_end.ru_nivcsw - usage_start.ru_nivcsw);
+    result->ctx_switches_per_io = completed_ios ? (double)ctx_switches / completed_ios : 0;
+    result->iops_per_core = cpu > 0 ? result->throughput * MB / config->io_size / result->cpu_cores : 0;
+}
+
+void print_latency_summary(const char* label, const latency_histogram* hist) {
+    printf("%s (us): min %.2f, mean %.2f, p50 %.2f, p90 %.2f, p99 %.2f, p99.9 %.2f, p99.99 %.2f, max %.2f\n",
+           label,
+           (hist->total ? hist->min : 0) / 1e3,
+           hist_mean(hist) / 1e3,
+           hist_percentile(hist, 50) / 1e3,
+           hist_percentile(hist, 90) / 1e3,
+           hist_percentile(hist, 99) / 1e3,
+           hist_percentile(hist, 99.9) / 1e3,
+           hist_percentile(hist, 99.99) / 1e3,
+           hist->max / 1e3);
+}
+
+// Parses a byte count with an optional K/M/G/T suffix (powers of 1024, optional trailing B)
+long parse_size(const char* arg) {
+    char* end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    long multiplier = 1;
+    switch (toupper((unsigned char)*end)) {
+        case 'K': multiplier = KB; end++; break;
+        case 'M': multiplier = MB; end++; break;
+        case 'G': multiplier = GB; end++; break;
+        case 'T': multiplier = TB; end++; break;
+    }
+    if (toupper((unsigned char)*end) == 'B') {
+        end++;
+    }
+    if (errno != 0 || end == arg || *end != '\0' || value < 0 || value > LONG_MAX / multiplier) {
+        fprintf(stderr, "Error: Invalid size '%s'\n", arg);
+        exit(1);
+    }
+    return value * multiplier;
+}
+
+// Size of a block device or regular file in bytes
+long device_size(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Failed to open device");
+        exit(1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat failed");
+        exit(1);
+    }
+    long size = st.st_size;
+    if (S_ISBLK(st.st_mode)) {
+        uint64_t bytes;
+        if (ioctl(fd, BLKGETSIZE64, &bytes) < 0) {
+            perror("BLKGETSIZE64 failed");
+            exit(1);
+        }
+        size = (long)bytes;
+    }
+    close(fd);
+    return size;
+}
+
+// Opens a CSV for appending, writing the header only when the file is new
+FILE* open_csv(const char* path, void (*write_header)(FILE*)) {
+    FILE* csv_fp;
+    // Check if the file exists first
+    if (access(path, F_OK) == -1) {
+        // File doesn't exist, create it and write the header
+        csv_fp = fopen(path, "w"); // Use "w" to create/truncate
+        if (!csv_fp) {
+            perror("Failed to create output file");
+            exit(1);
+        }
+        write_header(csv_fp);
+    } else {
+        // File exists, open it in append mode
+        csv_fp = fopen(path, "a");
+        if (!csv_fp) {
+            perror("Failed to open output file");
+            exit(1);
+        }
+    }
+    return csv_fp;
+}
+
+uint64_t fnv1a64(const char* str) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *str; str++) {
+        hash ^= (unsigned char)*str;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash ? hash : 1;
+}
+
+// Canonical description of a point; the seed is left out since it is time based by default
+void describe_point(benchmark_config* config, char* buf, size_t len) {
+    char dist[64];
+    format_dist(config, dist, sizeof(dist));
+    snprintf(buf, len, "device=%s output=%s op=%s rwmix=%d io_size=%ld stride=%ld range=%ld dist=%s "
+                       "iterations=%d ios=%ld runtime=%g ramp=%g engine=%s qd=%d threads=%d",
+             config->device, config->output_file ? config->output_file : "-", operation_name(config),
+             config->rwmix_read, config->io_size, config->stride_size, config->range, dist,
+             config->num_iterations, config->io_multiplier, config->runtime, config->ramp,
+             engine_name(config->engine), config->queue_depth, config->num_threads);
+    // Appended only when set so journals written before the option existed still match
+    if (config->target_ci > 0) {
+        size_t used = strlen(buf);
+        snprintf(buf + used, len - used, " target_ci=%g max_iterations=%d max_time=%g",
+                 config->target_ci, config->max_iterations, config->max_time);
+    }
+    if (config->fixed) {
+        size_t used = strlen(buf);
+        snprintf(buf + used, len - used, " fixed=1");
+    }
+    if (config->shared_fd) {
+        size_t used = strlen(buf);
+        snprintf(buf + used, len - used, " shared_fd=1");
+    }
+    if (config->compare_lseek && config->engine == ENGINE_SYNC) {
+        size_t used = strlen(buf);
+        snprintf(buf + used, len - used, " compare_lseek=1");
+    }
+    if (config->engine == ENGINE_PVSYNC2) {
+        size_t used = strlen(buf);
+        char rwf[32];
+        format_rwf(config->rwf_flags, rwf, sizeof(rwf));
+        used += snprintf(buf + used, len - used, " rwf=%s iovecs=", rwf);
+        for (int i = 0; i < config->num_iovecs && used < len; i++) {
+            used += snprintf(buf + used, len - used, "%s%ld", i ? "," : "",
+                             config->iovec_sizes ? config->iovec_sizes[i] : -1L);
+        }
+    }
+    if (config->batch_submit > 0 || config->batch_complete > 1) {
+        size_t used = strlen(buf);
+        snprintf(buf + used, len - used, " batch_submit=%d batch_complete=%d", config->batch_submit,
+                 config->batch_complete);
+    }
+    if (config->sqpoll || config->iopoll) {
+        size_t used = strlen(buf);
+        snprintf(buf + used, len - used, " uring_mode=%s sqpoll_cpu=%d", uring_mode_name(config), config->sqpoll_cpu);
+    }
+    if (config->rate > 0) {
+        size_t used = strlen(buf);
+        snprintf(buf + used, len - used, " rate=%g arrival=%s", config->rate, arrival_name(config->arrival));
+    }
+    if (config->steady_window > 0) {
+        size_t used = strlen(buf);
+        snprintf(buf + used, len - used, " steady_window=%d steady_max_rounds=%d",
+                 config->steady_window, config->steady_max_rounds);
+    }
+    // A truncated description could hash distinct points alike
+    if (strlen(buf) + 1 >= len) {
+        fprintf(stderr, "Error: Point description for --journal does not fit in %zu bytes\n", len - 1);
+        exit(1);
+    }
+}
+
+int journal_contains(progress_journal* journal, uint64_t hash) {
+    for (size_t i = hash % journal->capacity; journal->done[i]; i = (i + 1) % journal->capacity) {
+        if (journal->done[i] == hash) return 1;
+    }
+    return 0;
+}
+
+void journal_insert(progress_journal* journal, uint64_t hash) {
+    if (journal_contains(journal, hash)) {
+        return;
+    }
+    if ((journal->count + 1) * 2 > journal->capacity) {
+        progress_journal grown = {.capacity = journal->capacity * 2};
+        grown.done = calloc(grown.capacity, sizeof(uint64_t));
+        if (!grown.done) {
+            perror("Failed to grow journal");
+            exit(1);
+        }
+        for (size_t i = 0; i < journal->capacity; i++) {
+            if (journal->done[i]) journal_insert(&grown, journal->done[i]);
+        }
+        free(journal->done);
+        journal->done = grown.done;
+        journal->capacity = grown.capacity;
+    }
+    size_t i = hash % journal->capacity;
+    while (journal->done[i]) i = (i + 1) % journal->capacity;
+    journal->done[i] = hash;
+    journal->count++;
+}
+
+void journal_sync(progress_journal* journal) {
+    fflush(journal->fp);
+    if (fsync(fileno(journal->fp)) < 0) {
+        perror("Failed to sync journal");
+        exit(1);
+    }
+}
+
+// Loads finished points and rolls back the CSV rows of a point that was interrupted
+void journal_open(progress_journal* journal, const char* path) {
+    journal->capacity = 1024;
+    journal->count = 0;
+    journal->done = calloc(journal->capacity, sizeof(uint64_t));
+    journal->fp = fopen(path, "a+");
+    if (!journal->done || !journal->fp) {
+        perror("Failed to open journal");
         exit(1);
     }
-    if (config->stride_size % 4096 != 0) {
-        fprintf(stderr, "Error: Stride size must be 4K aligned\n");
+
+    uint64_t pending = 0;
+    long pending_size = -1;
+    char* pending_path = NULL;
+    long complete_bytes = 0;
+    // Records have no length limit, so only a last line without its newline is a torn write
+    char* line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+    rewind(journal->fp);
+    while ((len = getline(&line, &line_cap, journal->fp)) > 0) {
+        if (line[len - 1] != '\n') {
+            break;  // Torn final write
+        }
+        complete_bytes += len;
+        line[len - 1] = '\0';
+
+        unsigned long long hash;
+        long size;
+        int path_at = 0;
+        if (sscanf(line, "start %llx %ld %n", &hash, &size, &path_at) == 2 && path_at > 0) {
+            pending = hash;
+            pending_size = size;
+            free(pending_path);
+            pending_path = strdup(line + path_at);
+            if (!pending_path) {
+                perror("Failed to read journal");
+                exit(1);
+            }
+        } else if (sscanf(line, "done %llx", &hash) == 1) {
+            journal_insert(journal, hash);
+            if (hash == pending) pending = 0;
+        }
+    }
+    free(line);
+
+    // Drop a torn last line so new records start on a line of their own
+    if (ftruncate(fileno(journal->fp), complete_bytes) < 0) {
+        perror("Failed to repair journal");
         exit(1);
     }
-    if (config->range < config->io_size) {
-        fprintf(stderr, "Error: Range must be larger than I/O size\n");
+    fseek(journal->fp, 0, SEEK_END);
+
+    if (pending && pending_size >= 0 && pending_path && strcmp(pending_path, "-") != 0) {
+        struct stat st;
+        if (stat(pending_path, &st) == 0 && st.st_size > pending_size) {
+            printf("Journal: discarding partial results of an interrupted point from %s\n", pending_path);
+            if (truncate(pending_path, pending_size) < 0) {
+                perror("Failed to roll back interrupted results");
+                exit(1);
+            }
+        }
+    }
+    free(pending_path);
+    printf("Journal: %zu points already completed\n", journal->count);
+}
+
+void journal_close(progress_journal* journal) {
+    fclose(journal->fp);
+    free(journal->done);
+}
+
+long csv_size(FILE* csv_fp) {
+    struct stat st;
+    fflush(csv_fp);
+    if (fstat(fileno(csv_fp), &st) < 0) {
+        perror("fstat failed");
         exit(1);
     }
+    return st.st_size;
 }
 
-void write_csv_header(FILE* fp) {
-    fprintf(fp, "operation,io_size,stride_size,is_random,iteration,throughput,mean,stddev,ci95\n");
+void journal_start(progress_journal* journal, uint64_t hash, benchmark_config* config, FILE* csv_fp) {
+    fprintf(journal->fp, "start %016llx %ld %s\n", (unsigned long long)hash,
+            csv_fp ? csv_size(csv_fp) : -1L, csv_fp ? config->output_file : "-");
+    journal_sync(journal);
 }
 
-void write_csv_result(FILE* fp, benchmark_config* config, int iteration,
-                      double throughput, double mean, double stddev, double ci95) {
-    fprintf(fp, "%s,%d,%d,%s,%d,%.2f,%.2f,%.2f,%.2f\n",
-            config->is_write ? "write" : "read",
-            config->io_size,
-            config->stride_size,
-            config->is_random ? "true" : "false",
-            iteration,
-            throughput,
-            mean,
-            stddev,
-            ci95);
+// The point's rows reach the disk before it is marked done
+void journal_finish(progress_journal* journal, uint64_t hash, const char* description, FILE* csv_fp) {
+    if (csv_fp) {
+        fflush(csv_fp);
+        if (fsync(fileno(csv_fp)) < 0) {
+            perror("Failed to sync output file");
+            exit(1);
+        }
+    }
+    fprintf(journal->fp, "done %016llx %s\n", (unsigned long long)hash, description);
+    journal_sync(journal);
+    journal_insert(journal, hash);
 }
 
-double run_benchmark(benchmark_config* config) {
-    char* buffer;
-    int fd;
-    long total_bytes = 0;
-    long current_pos = 0;
+void sweep_add(sweep_list* list, long value) {
+    if (list->count == MAX_SWEEP_VALUES) {
+        fprintf(stderr, "Error: At most %d values can be swept per parameter\n", MAX_SWEEP_VALUES);
+        exit(1);
+    }
+    list->values[list->count++] = value;
+}
 
-    validate_config(config);
+// Parses a comma-separated list whose items are sizes or start:end[:step] ranges. The step
+// is xN for a geometric range or +N for an arithmetic one and defaults to x2, e.g.
+// "4K:1M" or "4K,64K,512K" or "0:64K:+16K"
+void parse_sweep_list(const char* arg, sweep_list* list) {
+    char* copy = strdup(arg);
+    char* save = NULL;
+    list->count = 0;
+    for (char* item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char* first_colon = strchr(item, ':');
+        if (!first_colon) {
+            sweep_add(list, parse_size(item));
+            continue;
+        }
 
-    if (posix_memalign((void**)&buffer, 4096, config->io_size) != 0) {
-        perror("posix_memalign failed");
+        *first_colon = '\0';
+        char* end_str = first_colon + 1;
+        char* step_str = strchr(end_str, ':');
+        if (step_str) {
+            *step_str++ = '\0';
+        }
+        long start = parse_size(item);
+        long end = parse_size(end_str);
+        int geometric = !step_str || step_str[0] == 'x' || step_str[0] == '*';
+        long step = 2;
+        if (step_str) {
+            step = parse_size(step_str + (step_str[0] == 'x' || step_str[0] == '*' || step_str[0] == '+'));
+        }
+        if (start > end || step < (geometric ? 2 : 1) || (geometric && start == 0)) {
+            fprintf(stderr, "Error: Invalid sweep range '%s'\n", arg);
+            exit(1);
+        }
+        for (long value = start; value <= end; value = geometric ? value * step : value + step) {
+            sweep_add(list, value);
+            if (value > LONG_MAX / step || value > LONG_MAX - step) break;
+        }
+    }
+    free(copy);
+    if (list->count == 0) {
+        fprintf(stderr, "Error: Empty value list '%s'\n", arg);
         exit(1);
     }
+}
+
+long sweep_max(const sweep_list* list) {
+    long max = list->values[0];
+    for (int i = 1; i < list->count; i++) {
+        if (list->values[i] > max) max = list->values[i];
+    }
+    return max;
+}
 
-    int flags = O_DIRECT | (config->is_write ? O_RDWR : O_RDONLY);
-    fd = open(config->device, flags);
-    if (fd < 0) {
-        perror("Failed to open device");
-        free(buffer);
+// Workload-independent preconditioning: fill the range sequentially, then overwrite it at random
+void precondition(benchmark_config* config, worker_resources* res, int queue_depth) {
+    run_result* result = malloc(sizeof(run_result));
+    if (!result) {
+        perror("Failed to allocate results");
         exit(1);
     }
+    benchmark_config pass = *config;
+    pass.is_write = 1;
+    pass.rwmix_read = -1;
+    pass.stride_size = 0;
+    pass.dist = DIST_UNIFORM;
+    pass.queue_depth = queue_depth;
+    pass.runtime = 0;
+    pass.ramp = 0;
+    pass.rate = 0;  // Fills the range as fast as the device allows, whatever load the job offers
+    // The job's iovec layout is sized for its own I/Os, not the pass's 128K and 4K writes
+    pass.num_iovecs = 1;
+    pass.iovec_sizes = NULL;
+    pass.rwf_flags = 0;
+    if (config->series) {
+        config->series->phase = "precondition";
+    }
 
-    double start = get_time();
+    for (int random = 0; random <= 1; random++) {
+        pass.is_random = random;
+        pass.io_size = random ? PRECONDITION_RANDOM_SIZE : PRECONDITION_SEQ_SIZE;
+        pass.io_multiplier = config->range / pass.io_size * config->precondition_passes;
+        printf("Preconditioning: %d x %ld bytes of %s %ld-byte writes... ", config->precondition_passes,
+               config->range, random ? "random" : "sequential", pass.io_size);
+        fflush(stdout);
+        run_benchmark(&pass, res, result);
+        printf("%.2f MB/s\n", result->throughput);
+    }
+    config->next_seed = pass.next_seed;
+    free(result);
+}
+
+// SNIA PTS steady state: the window's throughput stays within a range of STEADY_RANGE_PCT of its
+// average, and its least-squares line moves by no more than STEADY_SLOPE_PCT across the window
+int is_steady(const double* window, int n) {
+    double sum = 0, min = window[0], max = window[0];
+    for (int i = 0; i < n; i++) {
+        sum += window[i];
+        if (window[i] < min) min = window[i];
+        if (window[i] > max) max = window[i];
+    }
+    double mean = sum / n;
+    double x_mean = (n - 1) / 2.0, sxy = 0, sxx = 0;
+    for (int i = 0; i < n; i++) {
+        sxy += (i - x_mean) * (window[i] - mean);
+        sxx += (i - x_mean) * (i - x_mean);
+    }
+    double excursion = fabs(sxy / sxx) * (n - 1);
+    return max - min <= mean * STEADY_RANGE_PCT / 100 && excursion <= mean * STEADY_SLOPE_PCT / 100;
+}
+
+// Runs the point's own workload in unrecorded rounds until its throughput is steady
+void reach_steady_state(benchmark_config* config, worker_resources* res, run_result* result, steady_state* steady) {
+    double rounds[config->steady_max_rounds];
+    steady->rounds = 0;
+    steady->reached = 0;
+    if (config->series) {
+        config->series->phase = "steady";
+    }
+    while (steady->rounds < config->steady_max_rounds && !steady->reached) {
+        run_benchmark(config, res, result);
+        rounds[steady->rounds++] = result->throughput;
+        printf("Steady-state round %d: %.2f MB/s\n", steady->rounds, result->throughput);
+        if (steady->rounds >= config->steady_window) {
+            steady->reached = is_steady(rounds + steady->rounds - config->steady_window, config->steady_window);
+        }
+    }
+    if (steady->reached) {
+        printf("Steady state reached after %d rounds\n\n", steady->rounds);
+    } else {
+        fprintf(stderr, "Warning: steady state not reached within %d rounds, measuring anyway\n", steady->rounds);
+    }
+}
+
+// Runs every iteration of one configuration, printing and logging each and then a summary.
+// outcome, when given, receives the point's mean IOPS and overall p99
+void run_point(benchmark_config* config, worker_resources* res, FILE* csv_fp, point_outcome* outcome) {
+    int adaptive = config->target_ci > 0;
+    int max_iterations = adaptive ? config->max_iterations : config->num_iterations;
+    // A confidence interval needs at least two samples
+    int min_iterations = adaptive && config->num_iterations < 2 ? 2 : config->num_iterations;
+    double results[max_iterations];
+    welford acc = {0};
+    throughput_stats stats;
+    // totals accumulates histograms and per-direction throughput across iterations
+    run_result* result = malloc(sizeof(run_result));
+    run_result* totals = calloc(1, sizeof(run_result));
+    if (!result || !totals) {
+        perror("Failed to allocate results");
+        exit(1);
+    }
+    hist_reset(&totals->latency);
+    hist_reset(&totals->dir_latency[DIR_READ]);
+    hist_reset(&totals->dir_latency[DIR_WRITE]);
 
-    long target_bytes = (long)config->io_size * config->io_multiplier;
-    while (total_bytes < target_bytes) {
+    steady_state steady = {0, 0};
+    if (config->steady_window > 0) {
+        reach_steady_state(config, res, result, &steady);
+    }
+    if (config->series) {
+        config->series->phase = "measure";
+    }
 
-        if (config->is_random) {
-            long max_pos = config->range - config->io_size;
-            current_pos = (random() % (max_pos / 4096)) * 4096; // Ensure 4K alignment
+    double start = get_time();
+    int iterations = 0;
+    int converged = 0;
+    while (iterations < max_iterations && !converged) {
+        if (adaptive && iterations >= min_iterations && config->max_time > 0 &&
+            get_time() - start >= config->max_time) {
+            break;
+        }
+        int i = iterations++;
+        run_benchmark(config, res, result);
+        results[i] = result->throughput;
+        hist_merge(&totals->latency, &result->latency);
+        for (int dir = DIR_READ; dir <= DIR_WRITE; dir++) {
+            hist_merge(&totals->dir_latency[dir], &result->dir_latency[dir]);
+            totals->dir_throughput[dir] += result->dir_throughput[dir];
+        }
+        totals->cpu_cores += result->cpu_cores;
+        totals->iops_per_core += result->iops_per_core;
+        totals->syscalls_per_io += result->syscalls_per_io;
+        totals->ctx_switches_per_io += result->ctx_switches_per_io;
+        welford_add(&acc, results[i]);
+        printf("Iteration %d: %.2f MB/s, latency p50 %.2f us, p99 %.2f us, max %.2f us\n",
+               i + 1, results[i], hist_percentile(&result->latency, 50) / 1e3,
+               hist_percentile(&result->latency, 99) / 1e3, result->latency.max / 1e3);
+        if (config->rwmix_read >= 0) {
+            printf("  read %.2f MB/s (p99 %.2f us), write %.2f MB/s (p99 %.2f us)\n",
+                   result->dir_throughput[DIR_READ], hist_percentile(&result->dir_latency[DIR_READ], 99) / 1e3,
+                   result->dir_throughput[DIR_WRITE], hist_percentile(&result->dir_latency[DIR_WRITE], 99) / 1e3);
         }
 
-        if (lseek(fd, current_pos, SEEK_SET) < 0) {
-            perror("lseek failed");
-            close(fd);
-            free(buffer);
-            exit(1);
+        compute_stats(&acc, results, iterations, &stats);
+        converged = adaptive && iterations >= min_iterations && stats.mean > 0 &&
+                    stats.ci95 / stats.mean * 100 <= config->target_ci;
+        if (csv_fp) {
+            write_csv_result(csv_fp, config, iterations, &stats, converged, &steady, result);
         }
+    }
 
-        ssize_t bytes;
-        if (config->is_write) {
-            bytes = write(fd, buffer, config->io_size);
+    printf("\nResults Summary:\n");
+    printf("Average throughput: %.2f MB/s\n", stats.mean);
+    printf("Standard deviation: %.2f MB/s\n", stats.stddev);
+    printf("95%% Confidence Interval: %.2f ± %.2f MB/s (Student t, %d iterations)\n",
+           stats.mean, stats.ci95, iterations);
+    printf("Median throughput: %.2f MB/s (MAD %.2f MB/s)\n", stats.median, stats.mad);
+    if (adaptive) {
+        double relative = stats.mean > 0 ? stats.ci95 / stats.mean * 100 : 0;
+        if (converged) {
+            printf("Converged to ±%.2f%% (target %g%%) after %d iterations\n", relative, config->target_ci, iterations);
         } else {
-            bytes = read(fd, buffer, config->io_size);
+            printf("Did not converge: ±%.2f%% (target %g%%) when the budget ran out after %d iterations\n",
+                   relative, config->target_ci, iterations);
         }
+    }
+    print_latency_summary("Latency", &totals->latency);
+    printf("CPU: %.2f cores busy, %.0f IOPS per core, %.3f syscalls and %.3f context switches per I/O\n",
+           totals->cpu_cores / iterations, totals->iops_per_core / iterations, totals->syscalls_per_io / iterations,
+           totals->ctx_switches_per_io / iterations);
+    if (config->rwmix_read >= 0) {
+        printf("Average read throughput: %.2f MB/s\n", totals->dir_throughput[DIR_READ] / iterations);
+        print_latency_summary("Read latency", &totals->dir_latency[DIR_READ]);
+        printf("Average write throughput: %.2f MB/s\n", totals->dir_throughput[DIR_WRITE] / iterations);
+        print_latency_summary("Write latency", &totals->dir_latency[DIR_WRITE]);
+    }
+    if (outcome) {
+        outcome->iops = stats.mean * MB / config->io_size;
+        outcome->mean_us = hist_mean(&totals->latency) / 1e3;
+        outcome->p99_us = hist_percentile(&totals->latency, 99) / 1e3;
+        outcome->syscalls_per_io = totals->syscalls_per_io / iterations;
+    }
 
-        if (bytes != config->io_size) {
-            fprintf(stderr, "I/O operation failed: expected %d bytes, got %zd bytes\n", config->io_size, bytes);
-            close(fd);
-            free(buffer);
-            exit(1);
-        }
+    free(result);
+    free(totals);
+}
 
-        total_bytes += config->io_size;
-        if (!config->is_random) {
-            current_pos += config->io_size + config->stride_size;
-            if (current_pos + config->io_size > config->range) {
-                current_pos = 0;
-            }
-        }
+// With --compare-lseek, reruns a sync point on the legacy lseek + read/write path and reports
+// what the extra syscall costs, to reconcile results recorded before pread became the default
+void run_point_with_legacy(benchmark_config* config, worker_resources* res, FILE* csv_fp) {
+    if (!config->compare_lseek || config->engine != ENGINE_SYNC) {
+        run_point(config, res, csv_fp, NULL);
+        return;
     }
+    point_outcome positional, legacy;
+    run_point(config, res, csv_fp, &positional);
+    printf("\n--- Same point on the legacy lseek engine ---\n");
+    config->engine = ENGINE_LSEEK;
+    run_point(config, res, csv_fp, &legacy);
+    config->engine = ENGINE_SYNC;
+
+    printf("\nSync overhead report:\n");
+    printf("  pread/pwrite:     %10.0f IOPS, mean %8.2f us, p99 %8.2f us, %.2f syscalls per I/O\n",
+           positional.iops, positional.mean_us, positional.p99_us, positional.syscalls_per_io);
+    printf("  lseek+read/write: %10.0f IOPS, mean %8.2f us, p99 %8.2f us, %.2f syscalls per I/O\n",
+           legacy.iops, legacy.mean_us, legacy.p99_us, legacy.syscalls_per_io);
+    printf("  The lseek path adds %.2f us per I/O and %s %.1f%% IOPS\n", legacy.mean_us - positional.mean_us,
+           legacy.iops <= positional.iops ? "loses" : "gains",
+           positional.iops > 0 ? fabs(1 - legacy.iops / positional.iops) * 100 : 0);
+}
 
-    if (config->is_write) {
-        fsync(fd);
+void measure_load(benchmark_config* config, worker_resources* res, FILE* csv_fp, double load, knee_step* step) {
+    int open_loop = config->rate > 0;
+    if (open_loop) {
+        config->rate = load;
+        printf("\n--- Knee search: %.0f IOPS offered ---\n", load);
+    } else {
+        config->queue_depth = (int)load;
+        printf("\n--- Knee search: queue depth %d ---\n", config->queue_depth);
     }
+    point_outcome outcome;
+    run_point(config, res, csv_fp, &outcome);
+    step->load = load;
+    step->iops = outcome.iops;
+    step->p99_us = outcome.p99_us;
+    step->ok = outcome.p99_us <= config->knee_slo_us && (!open_loop || outcome.iops >= load * KNEE_SATURATION);
+}
 
-    double end = get_time();
+int compare_knee_step(const void* a, const void* b) {
+    const knee_step* x = a;
+    const knee_step* y = b;
+    return (x->load > y->load) - (x->load < y->load);
+}
 
-    close(fd);
-    free(buffer);
+// The knee is the first step past which no later step adds KNEE_GAIN_PCT IOPS per doubling of
+// the load, and where p99 takes off at the next step. Only the geometric ladder is considered:
+// bisection steps are a few percent apart, too close to tell flat throughput from noise
+int knee_on_ladder(const knee_step* ladder, int count) {
+    for (int i = 0; i + 1 < count; i++) {
+        if (ladder[i + 1].p99_us < ladder[i].p99_us * (1 + KNEE_P99_GROWTH_PCT / 100.0)) {
+            continue;
+        }
+        int flat = 1;
+        for (int j = i + 1; j < count && flat; j++) {
+            double doublings = log2(ladder[j].load / ladder[i].load);
+            flat = ladder[j].iops < ladder[i].iops * (1 + KNEE_GAIN_PCT / 100.0 * doublings);
+        }
+        if (flat) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Steps the queue depth (or the offered rate with --rate) up geometrically until the p99 SLO
+// breaks, bisects between the last passing and first failing load, then reports the knee and
+// the highest IOPS sustained within the SLO
+void find_knee(benchmark_config* config, worker_resources* res, FILE* csv_fp, int max_depth) {
+    int open_loop = config->rate > 0;
+    double initial = open_loop ? config->rate : config->queue_depth;
+    knee_step steps[KNEE_MAX_STEPS];
+    int count = 0;
+    double pass = 0, fail = 0;
+
+    double load = open_loop ? config->rate : 1;
+    while (count < KNEE_MAX_STEPS) {
+        knee_step* step = &steps[count++];
+        measure_load(config, res, csv_fp, load, step);
+        if (!step->ok) {
+            fail = load;
+            break;
+        }
+        pass = load;
+        if (!open_loop && load >= max_depth) {
+            break;
+        }
+        load = open_loop ? load * 2 : (load * 2 < max_depth ? load * 2 : max_depth);
+    }
+    int ladder = count;
+    int knee = knee_on_ladder(steps, ladder);
+    knee_step knee_at, knee_next;
+    if (knee >= 0) {
+        knee_at = steps[knee];
+        knee_next = steps[knee + 1];
+    }
+    while (pass > 0 && fail > 0 && count < KNEE_MAX_STEPS &&
+           (open_loop ? fail / pass > KNEE_RATE_RESOLUTION : fail - pass > 1)) {
+        load = open_loop ? (pass + fail) / 2 : floor((pass + fail) / 2);
+        knee_step* step = &steps[count++];
+        measure_load(config, res, csv_fp, load, step);
+        if (step->ok) {
+            pass = load;
+        } else {
+            fail = load;
+        }
+    }
+    if (open_loop) {
+        config->rate = initial;
+    } else {
+        config->queue_depth = (int)initial;
+    }
 
-    return (double)total_bytes / (end - start) / MB;
+    qsort(steps, count, sizeof(knee_step), compare_knee_step);
+    const char* unit = open_loop ? "offered IOPS" : "queue depth";
+    printf("\nKnee search (p99 SLO %.2f us):\n", config->knee_slo_us);
+    printf("%14s %12s %12s %s\n", unit, "IOPS", "p99 (us)", "SLO");
+    int best = -1;
+    for (int i = 0; i < count; i++) {
+        printf("%14.0f %12.0f %12.2f %s\n", steps[i].load, steps[i].iops, steps[i].p99_us, steps[i].ok ? "met" : "missed");
+        if (steps[i].ok && (best < 0 || steps[i].iops > steps[best].iops)) {
+            best = i;
+        }
+    }
+    if (knee >= 0) {
+        printf("Knee at %s %.0f: %.0f IOPS, p99 %.2f us; higher loads add under %d%% IOPS per doubling, "
+               "and p99 reaches %.2f us at %.0f\n", unit, knee_at.load, knee_at.iops, knee_at.p99_us, KNEE_GAIN_PCT,
+               knee_next.p99_us, knee_next.load);
+    } else if (ladder < 2) {
+        printf("No knee: the first load already ended the search\n");
+    } else {
+        printf("No knee: throughput kept growing by %d%% per doubling, or p99 never grew by %d%% as it flattened\n",
+               KNEE_GAIN_PCT, KNEE_P99_GROWTH_PCT);
+    }
+    if (best >= 0) {
+        printf("Max sustainable: %.0f IOPS at %s %.0f (p99 %.2f us)\n",
+               steps[best].iops, unit, steps[best].load, steps[best].p99_us);
+    } else {
+        printf("Max sustainable: none, even the lowest load missed the SLO\n");
+    }
 }
 
 void print_usage() {
     printf("Usage: benchmark [options]\n");
+    printf("Sizes accept K, M, G and T suffixes (powers of 1024), e.g. 4K or 8T\n");
     printf("Options:\n");
     printf("  -d <device>      Device to test (e.g., /dev/sda2)\n");
-    printf("  -s <size>        I/O size in bytes (4KB-100MB)\n");
-    printf("  -t <stride>      Stride size in bytes (0-100MB)\n");
-    printf("  -r <range>       Range for random I/Os in bytes (up to 1GB)\n");
+    printf("  -s <size>        I/O size in bytes (4K-2G)\n");
+    printf("  -t <stride>      Stride size in bytes\n");
+    printf("                   -s, -t and -q also take lists and ranges to sweep in one process,\n");
+    printf("                   e.g. -s 4K,64K,1M or -s 4K:100M (x2 steps) or -t 0:64K:+16K\n");
+    printf("  -r <range>       Range of the device covered by all patterns (default: 1G, 0 for the whole device)\n");
     printf("  -w               Perform write test (default is read)\n");
     printf("  -R               Perform random I/Os (default is sequential)\n");
+    printf("  --rwmix <pct>    Interleave reads and writes, <pct> percent of I/Os being reads\n");
     printf("  -n <iterations>  Number of iterations (default: 5)\n");
+    printf("  --target-ci <pct>  Repeat iterations until the 95%% CI half-width is within <pct>%% of\n");
+    printf("                   the mean; -n is then the minimum\n");
+    printf("  --max-iterations <n>  Iteration budget for --target-ci (default: 100)\n");
+    printf("  --max-time <sec> Time budget per point for --target-ci (default: none)\n");
+    printf("  --precondition <passes>  Before the job, write the range <passes> times sequentially\n");
+    printf("                   (128K) and then randomly (4K); destroys the data on the device\n");
+    printf("  --steady-state <rounds>  Run unrecorded rounds of each point until the last <rounds> are\n");
+    printf("                   steady (SNIA PTS range 20%%, slope 10%%) before measuring\n");
+    printf("  --steady-max-rounds <n>  Rounds to give up on steady state after (default: 25)\n");
+    printf("  --log <file>     Append per-interval IOPS, throughput and latency to a time-series CSV\n");
+    printf("  --log-interval <ms>  Sampling interval of --log (default: 1000)\n");
     printf("  -o <file>        Output CSV file\n");
     printf("  -m <multiplier>  How many IOs to perform (default: %ld)\n", GB/4096);
+    printf("  --runtime <sec>  Run each iteration for a fixed time instead of -m I/Os\n");
+    printf("  --ramp <sec>     Warm-up time per iteration excluded from the stats (default: 0)\n");
+    printf("  -e <engine>      I/O engine: sync (pread/pwrite), lseek (lseek + read/write, the old\n");
+    printf("                   default), io_uring, libaio, pvsync2, threadpool (a producer thread feeding\n");
+    printf("                   -j blocking pread/pwrite workers through a lock-free queue) (default: sync)\n");
+    printf("  --compare-lseek  Rerun each sync point on the lseek engine and report the overhead\n");
+    printf("  --shared-fd      Let all threads share one fd (not with the lseek engine)\n");
+    printf("  --iovecs <k>     pvsync2: split each I/O into <k> 4K-aligned iovecs (default: 1)\n");
+    printf("  --iovec-sizes <list>  pvsync2: explicit iovec sizes, e.g. 4K,4K,8K; their sum is the I/O size\n");
+    printf("  --rwf <flags>    pvsync2: RWF flags for preadv2/pwritev2: hipri, nowait, dsync (comma-separated)\n");
+    printf("  -q <depth>       I/Os kept in flight by async engines, or the threadpool queue size, rounded\n");
+    printf("                   up to a power of two of at least 2 (1-4096, default: 1)\n");
+    printf("  --batch-submit <n>    Async engines: submit at most <n> I/Os per syscall (default: all ready)\n");
+    printf("  --batch-complete <n>  Async engines: wait for <n> completions per syscall (default: 1)\n");
+    printf("  --fixed          io_uring: register the buffers and fd once and use READ/WRITE_FIXED\n");
+    printf("  --sqpoll         io_uring: submit through a kernel polling thread instead of syscalls\n");
+    printf("  --sqpoll-cpu <n> Pin the SQPOLL thread to CPU <n> (implies --sqpoll)\n");
+    printf("  --iopoll         io_uring: poll for completions instead of taking interrupts (needs a\n");
+    printf("                   device with poll queues, e.g. NVMe with nvme.poll_queues set)\n");
+    printf("  --hugepages <on|off>  Back I/O buffers with huge pages when available (default: on)\n");
+    printf("  -j <threads>     Worker threads, each with its own fd and slice of the range (default: 1)\n");
+    printf("  --rate <iops>    Issue I/Os open-loop at this total rate; latency counts from the intended\n");
+    printf("                   send time, so queueing behind a slow device is not omitted\n");
+    printf("  --arrival <process>  Inter-arrival times of --rate: fixed or poisson (default: fixed)\n");
+    printf("  --knee <p99_us>  Step the queue depth up to -q (default: %d), or the offered rate from\n", KNEE_DEFAULT_MAX_DEPTH);
+    printf("                   --rate, to find the throughput knee and the max IOPS within a p99 SLO\n");
+    printf("  --dist <name>    Random offset distribution (implies -R, default: uniform):\n");
+    printf("                   uniform, permute, zipf[:theta], pareto[:h], hotcold[:io_pct[:range_pct]]\n");
+    printf("  --seed <n>       Seed for random offsets, to reproduce a run (default: time based)\n");
+    printf("  --job <file>     Run the jobs described by an INI job file (see jobs/)\n");
+    printf("  --journal <file> Record finished points durably and skip them when rerun, to resume sweeps\n");
+    printf("Every option also has a long form (--device, --size, --stride, --range, --write,\n");
+    printf("--random, --iterations, --output, --ios, --engine, --iodepth, --threads); the same\n");
+    printf("names are the keys of a job file.\n");
 }
 
-int main(int argc, char* argv[]) {
-    benchmark_config config = {
-            .device = NULL,
-            .io_size = 4 * KB,
-            .stride_size = 0,
-            .range = GB,
-            .is_write = 0,
-            .is_random = 0,
-            .num_iterations = 5,
-            .output_file = NULL,
-            .io_multiplier = GB/4096  // Default to 1GB worth of 4K blocks
-    };
-
-    int opt;
-    while ((opt = getopt(argc, argv, "d:s:t:r:wRn:o:m:h")) != -1) {
-        switch (opt) {
-            case 'd': config.device = optarg; break;
-            case 's': config.io_size = atoi(optarg); break;
-            case 't': config.stride_size = atoi(optarg); break;
-            case 'r': config.range = atol(optarg); break;
-            case 'w': config.is_write = 1; break;
-            case 'R': config.is_random = 1; break;
-            case 'n': config.num_iterations = atoi(optarg); break;
-            case 'o': config.output_file = optarg; break;
-            case 'm': config.io_multiplier = atol(optarg); break;
-            case 'h':
-            default: print_usage(); exit(1);
-        }
-    }
-
-    if (!config.device) {
+// Runs one job: a configuration plus the sizes, strides and queue depths it sweeps
+void run_job(benchmark_config* config, sweep_spec* sweep, const char* name) {
+    if (!config->device) {
         fprintf(stderr, "Error: Device parameter (-d) is required\n");
         print_usage();
         exit(1);
     }
 
-    srandom(time(NULL));
+    if (config->range == 0) {
+        config->range = device_size(config->device);
+    }
+
+    // A queue-depth knee search owns the depth, and the -q value only bounds it
+    int max_depth = (int)sweep_max(&sweep->depths);
+    if (config->knee_slo_us > 0 && config->rate == 0) {
+        if (!engine_uses_depth(config->engine)) {
+            fprintf(stderr, "Error: --knee steps the queue depth, which needs an async or threadpool engine (or use --rate)\n");
+            exit(1);
+        }
+        if (max_depth == 1) {
+            max_depth = KNEE_DEFAULT_MAX_DEPTH;
+        }
+        sweep->depths.count = 1;
+        sweep->depths.values[0] = max_depth;
+    }
+    if (config->knee_slo_us > 0 && config->journal_file) {
+        fprintf(stderr, "Warning: --journal does not apply to --knee searches\n");
+    }
+
+    if (!engine_uses_depth(config->engine) && (sweep->depths.count > 1 || sweep->depths.values[0] != 1)) {
+        fprintf(stderr, "Warning: %s engine always runs at queue depth 1, ignoring -q\n", engine_name(config->engine));
+        sweep->depths.count = 1;
+        sweep->depths.values[0] = 1;
+    }
+
+    // Explicit iovec sizes fix the I/O size to their sum
+    if (config->iovec_sizes) {
+        long total = 0;
+        for (int i = 0; i < config->num_iovecs; i++) {
+            total += config->iovec_sizes[i];
+        }
+        sweep->io_sizes.count = 1;
+        sweep->io_sizes.values[0] = total;
+    }
+
+    int num_points = sweep->io_sizes.count * sweep->strides.count * sweep->depths.count;
+    config->io_size = sweep->io_sizes.values[0];
+    config->stride_size = sweep->strides.values[0];
+    config->queue_depth = (int)sweep->depths.values[0];
+
+    // Check every point up front so a bad value cannot abort a sweep halfway through
+    for (int i = 0; i < sweep->io_sizes.count; i++) {
+        for (int j = 0; j < sweep->strides.count; j++) {
+            for (int k = 0; k < sweep->depths.count; k++) {
+                benchmark_config point = *config;
+                point.io_size = sweep->io_sizes.values[i];
+                point.stride_size = sweep->strides.values[j];
+                point.queue_depth = (int)sweep->depths.values[k];
+                validate_config(&point);
+            }
+        }
+    }
+
+    config->next_seed = config->seed;
 
+    if (name) {
+        printf("\n##### Job: %s #####\n", name);
+    }
     printf("Running benchmark with following configuration:\n");
-    printf("Device: %s\n", config.device);
-    printf("I/O Size: %d bytes\n", config.io_size);
-    printf("Stride Size: %d bytes\n", config.stride_size);
-    printf("Range: %ld bytes\n", config.range);
-    printf("Operation: %s\n", config.is_write ? "Write" : "Read");
-    printf("Pattern: %s\n", config.is_random ? "Random" : "Sequential");
-    printf("Iterations: %d\n\n", config.num_iterations);
-
-    // Open CSV file if specified
-    FILE* csv_fp = NULL;
-    if (config.output_file) {
-        // Check if the file exists first
-        if (access(config.output_file, F_OK) == -1) {
-            // File doesn't exist, create it and write the header
-            csv_fp = fopen(config.output_file, "w"); // Use "w" to create/truncate
-            if (!csv_fp) {
-                perror("Failed to create output file");
+    printf("Device: %s\n", config->device);
+    if (num_points > 1) {
+        printf("Sweep: %d points (%d I/O sizes x %d strides x %d queue depths)\n", num_points,
+               sweep->io_sizes.count, sweep->strides.count, sweep->depths.count);
+    } else {
+        printf("I/O Size: %ld bytes\n", config->io_size);
+        printf("Stride Size: %ld bytes\n", config->stride_size);
+    }
+    printf("Range: %ld bytes\n", config->range);
+    if (config->rwmix_read >= 0) {
+        printf("Operation: Mixed (%d%% read / %d%% write)\n", config->rwmix_read, 100 - config->rwmix_read);
+    } else {
+        printf("Operation: %s\n", config->is_write ? "Write" : "Read");
+    }
+    printf("Pattern: %s\n", config->is_random ? "Random" : "Sequential");
+    if (config->is_random) {
+        char dist[64];
+        format_dist(config, dist, sizeof(dist));
+        printf("Distribution: %s\n", dist);
+    }
+    if (num_points > 1) {
+        printf("Engine: %s\n", engine_name(config->engine));
+    } else {
+        printf("Engine: %s (queue depth %d)\n", engine_name(config->engine), config->queue_depth);
+    }
+    if (config->engine == ENGINE_PVSYNC2) {
+        char rwf[32];
+        format_rwf(config->rwf_flags, rwf, sizeof(rwf));
+        printf("Vectored I/O: %d iovecs, RWF flags %s\n", config->num_iovecs, rwf);
+    }
+    if (config->sqpoll || config->iopoll) {
+        printf("io_uring mode: %s", uring_mode_name(config));
+        if (config->sqpoll && config->sqpoll_cpu >= 0) {
+            printf(", SQPOLL thread on CPU %d", config->sqpoll_cpu);
+        }
+        printf("\n");
+    }
+    printf("Threads: %d\n", config->num_threads);
+    if (config->rate > 0) {
+        printf("Rate: %g IOPS open-loop, %s inter-arrival times\n", config->rate, arrival_name(config->arrival));
+    }
+    printf("Seed: %llu\n", (unsigned long long)config->seed);
+    if (config->runtime > 0) {
+        printf("Runtime: %.1f s per iteration (%.1f s ramp)\n", config->runtime, config->ramp);
+    } else if (config->ramp > 0) {
+        printf("Ramp: %.1f s per iteration\n", config->ramp);
+    }
+    if (config->target_ci > 0) {
+        printf("Iterations: until the 95%% CI is within ±%g%% (%d to %d", config->target_ci,
+               config->num_iterations < 2 ? 2 : config->num_iterations, config->max_iterations);
+        if (config->max_time > 0) {
+            printf(", at most %.1f s", config->max_time);
+        }
+        printf(")\n");
+    } else {
+        printf("Iterations: %d\n", config->num_iterations);
+    }
+    if (config->precondition_passes > 0) {
+        printf("Preconditioning: %d sequential and %d random passes over the range\n",
+               config->precondition_passes, config->precondition_passes);
+    }
+    if (config->steady_window > 0) {
+        printf("Steady state: %d-round window, at most %d rounds\n", config->steady_window, config->steady_max_rounds);
+    }
+    printf("\n");
+
+    progress_journal journal;
+    if (config->journal_file) {
+        journal_open(&journal, config->journal_file);
+    }
+
+    FILE* csv_fp = config->output_file ? open_csv(config->output_file, write_csv_header) : NULL;
+    interval_log series = {NULL, 0, "measure"};
+    if (config->log_file) {
+        series.fp = open_csv(config->log_file, write_log_header);
+        config->series = &series;
+    }
+
+    // One set of fds and buffers, sized for the largest point, serves the whole sweep
+    long max_io_size = sweep_max(&sweep->io_sizes);
+    if (config->precondition_passes > 0 && max_io_size < PRECONDITION_SEQ_SIZE) {
+        max_io_size = PRECONDITION_SEQ_SIZE;
+    }
+    size_t buffer_bytes = buffer_bytes_needed(config, max_io_size, (int)sweep_max(&sweep->depths));
+    worker_resources* res = resources_create(config, buffer_bytes);
+
+    if (config->precondition_passes > 0) {
+        precondition(config, res, (int)sweep_max(&sweep->depths));
+    }
+
+    for (int i = 0; i < sweep->io_sizes.count; i++) {
+        for (int j = 0; j < sweep->strides.count; j++) {
+            for (int k = 0; k < sweep->depths.count; k++) {
+                config->io_size = sweep->io_sizes.values[i];
+                config->stride_size = sweep->strides.values[j];
+                config->queue_depth = (int)sweep->depths.values[k];
+                if (num_points > 1) {
+                    printf("\n=== I/O size %ld, stride %ld, queue depth %d ===\n",
+                           config->io_size, config->stride_size, config->queue_depth);
+                }
+                if (config->knee_slo_us > 0) {
+                    find_knee(config, res, csv_fp, max_depth);
+                    continue;
+                }
+                if (!config->journal_file) {
+                    run_point_with_legacy(config, res, csv_fp);
+                    continue;
+                }
+
+                char description[8192];
+                describe_point(config, description, sizeof(description));
+                uint64_t hash = fnv1a64(description);
+                if (journal_contains(&journal, hash)) {
+                    printf("Already completed according to %s, skipping\n", config->journal_file);
+                    continue;
+                }
+                journal_start(&journal, hash, config, csv_fp);
+                run_point_with_legacy(config, res, csv_fp);
+                journal_finish(&journal, hash, description, csv_fp);
+            }
+        }
+    }
+
+    resources_destroy(config, res);
+    if (config->series) {
+        fclose(series.fp);
+        config->series = NULL;
+        printf("Time series written to %s\n", config->log_file);
+    }
+    if (config->journal_file) {
+        journal_close(&journal);
+    }
+
+    if (csv_fp) {
+        fclose(csv_fp);
+        printf("CSV output written to %s\n", config->output_file);
+    }
+
+}
+
+enum { OPT_SEED = 256, OPT_DIST, OPT_RWMIX, OPT_RUNTIME, OPT_RAMP, OPT_JOB, OPT_JOURNAL,
+       OPT_TARGET_CI, OPT_MAX_ITERATIONS, OPT_MAX_TIME, OPT_PRECONDITION, OPT_STEADY_STATE,
+       OPT_STEADY_MAX_ROUNDS, OPT_LOG, OPT_LOG_INTERVAL,
+       OPT_RATE, OPT_ARRIVAL, OPT_KNEE, OPT_HUGEPAGES, OPT_FIXED,
+       OPT_SQPOLL, OPT_SQPOLL_CPU, OPT_IOPOLL, OPT_BATCH_SUBMIT, OPT_BATCH_COMPLETE,
+       OPT_IOVECS, OPT_IOVEC_SIZES, OPT_RWF, OPT_SHARED_FD, OPT_COMPARE_LSEEK };
+
+// Long option names double as job file keys
+static const struct option long_options[] = {
+        {"device", required_argument, NULL, 'd'},
+        {"size", required_argument, NULL, 's'},
+        {"stride", required_argument, NULL, 't'},
+        {"range", required_argument, NULL, 'r'},
+        {"write", no_argument, NULL, 'w'},
+        {"random", no_argument, NULL, 'R'},
+        {"iterations", required_argument, NULL, 'n'},
+        {"output", required_argument, NULL, 'o'},
+        {"ios", required_argument, NULL, 'm'},
+        {"engine", required_argument, NULL, 'e'},
+        {"iodepth", required_argument, NULL, 'q'},
+        {"threads", required_argument, NULL, 'j'},
+        {"seed", required_argument, NULL, OPT_SEED},
+        {"dist", required_argument, NULL, OPT_DIST},
+        {"rwmix", required_argument, NULL, OPT_RWMIX},
+        {"runtime", required_argument, NULL, OPT_RUNTIME},
+        {"ramp", required_argument, NULL, OPT_RAMP},
+        {"journal", required_argument, NULL, OPT_JOURNAL},
+        {"target-ci", required_argument, NULL, OPT_TARGET_CI},
+        {"max-iterations", required_argument, NULL, OPT_MAX_ITERATIONS},
+        {"max-time", required_argument, NULL, OPT_MAX_TIME},
+        {"precondition", required_argument, NULL, OPT_PRECONDITION},
+        {"steady-state", required_argument, NULL, OPT_STEADY_STATE},
+        {"steady-max-rounds", required_argument, NULL, OPT_STEADY_MAX_ROUNDS},
+        {"log", required_argument, NULL, OPT_LOG},
+        {"log-interval", required_argument, NULL, OPT_LOG_INTERVAL},
+        {"rate", required_argument, NULL, OPT_RATE},
+        {"arrival", required_argument, NULL, OPT_ARRIVAL},
+        {"knee", required_argument, NULL, OPT_KNEE},
+        {"hugepages", required_argument, NULL, OPT_HUGEPAGES},
+        {"fixed", no_argument, NULL, OPT_FIXED},
+        {"sqpoll", no_argument, NULL, OPT_SQPOLL},
+        {"sqpoll-cpu", required_argument, NULL, OPT_SQPOLL_CPU},
+        {"iopoll", no_argument, NULL, OPT_IOPOLL},
+        {"batch-submit", required_argument, NULL, OPT_BATCH_SUBMIT},
+        {"batch-complete", required_argument, NULL, OPT_BATCH_COMPLETE},
+        {"iovecs", required_argument, NULL, OPT_IOVECS},
+        {"iovec-sizes", required_argument, NULL, OPT_IOVEC_SIZES},
+        {"rwf", required_argument, NULL, OPT_RWF},
+        {"shared-fd", no_argument, NULL, OPT_SHARED_FD},
+        {"compare-lseek", no_argument, NULL, OPT_COMPARE_LSEEK},
+        {"job", required_argument, NULL, OPT_JOB},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+};
+
+// Parses a comma-separated list of segment sizes; the list stays allocated for the process
+void parse_iovec_sizes(benchmark_config* config, const char* arg) {
+    char copy[4096];
+    snprintf(copy, sizeof(copy), "%s", arg);
+    long* sizes = malloc(IOV_MAX * sizeof(long));
+    if (!sizes) {
+        perror("Failed to allocate iovec sizes");
+        exit(1);
+    }
+    int count = 0;
+    for (char* save = NULL, *token = strtok_r(copy, ",", &save); token; token = strtok_r(NULL, ",", &save)) {
+        if (count == IOV_MAX) {
+            fprintf(stderr, "Error: At most %d iovecs are supported\n", IOV_MAX);
+            exit(1);
+        }
+        sizes[count++] = parse_size(token);
+    }
+    config->iovec_sizes = sizes;
+    config->num_iovecs = count;
+}
+
+// Flags are bare on the command line (value NULL) and spelled out in job files
+int parse_flag(const char* value) {
+    if (!value || strcmp(value, "1") == 0 || strcasecmp(value, "true") == 0 ||
+        strcasecmp(value, "yes") == 0 || strcasecmp(value, "on") == 0) {
+        return 1;
+    }
+    if (strcmp(value, "0") == 0 || strcasecmp(value, "false") == 0 ||
+        strcasecmp(value, "no") == 0 || strcasecmp(value, "off") == 0) {
+        return 0;
+    }
+    fprintf(stderr, "Error: Invalid boolean '%s'\n", value);
+    exit(1);
+}
+
+// Applies one option from the command line or a job file; returns 0 for options it does not set
+int apply_option(benchmark_config* config, sweep_spec* sweep, int opt, const char* value) {
+    switch (opt) {
+        case 'd': config->device = (char*)value; break;
+        case 's': parse_sweep_list(value, &sweep->io_sizes); break;
+        case 't': parse_sweep_list(value, &sweep->strides); break;
+        case 'r': config->range = parse_size(value); break;
+        case 'w': config->is_write = parse_flag(value); break;
+        case 'R': config->is_random = parse_flag(value); break;
+        case 'n': config->num_iterations = atoi(value); break;
+        case 'o': config->output_file = (char*)value; break;
+        case 'm': config->io_multiplier = atol(value); break;
+        case 'e': config->engine = parse_engine(value); break;
+        case 'q': parse_sweep_list(value, &sweep->depths); break;
+        case 'j': config->num_threads = atoi(value); break;
+        case OPT_SEED: config->seed = strtoull(value, NULL, 0); break;
+        case OPT_DIST: parse_dist(config, value); break;
+        case OPT_RWMIX: config->rwmix_read = atoi(value); break;
+        case OPT_RUNTIME: config->runtime = atof(value); break;
+        case OPT_RAMP: config->ramp = atof(value); break;
+        case OPT_JOURNAL: config->journal_file = (char*)value; break;
+        case OPT_TARGET_CI: config->target_ci = atof(value); break;
+        case OPT_MAX_ITERATIONS: config->max_iterations = atoi(value); break;
+        case OPT_MAX_TIME: config->max_time = atof(value); break;
+        case OPT_PRECONDITION: config->precondition_passes = atoi(value); break;
+        case OPT_STEADY_STATE: config->steady_window = atoi(value); break;
+        case OPT_STEADY_MAX_ROUNDS: config->steady_max_rounds = atoi(value); break;
+        case OPT_LOG: config->log_file = (char*)value; break;
+        case OPT_LOG_INTERVAL: config->log_interval_ms = atoi(value); break;
+        case OPT_RATE: config->rate = atof(value); break;
+        case OPT_ARRIVAL: config->arrival = parse_arrival(value); break;
+        case OPT_KNEE: config->knee_slo_us = atof(value); break;
+        case OPT_HUGEPAGES: config->hugepages = parse_flag(value); break;
+        case OPT_FIXED: config->fixed = parse_flag(value); break;
+        case OPT_SQPOLL: config->sqpoll = parse_flag(value); break;
+        case OPT_SQPOLL_CPU: config->sqpoll_cpu = atoi(value); config->sqpoll = 1; break;
+        case OPT_IOPOLL: config->iopoll = parse_flag(value); break;
+        case OPT_BATCH_SUBMIT: config->batch_submit = atoi(value); break;
+        case OPT_BATCH_COMPLETE: config->batch_complete = atoi(value); break;
+        case OPT_IOVECS: config->num_iovecs = atoi(value); config->iovec_sizes = NULL; break;
+        case OPT_IOVEC_SIZES: parse_iovec_sizes(config, value); break;
+        case OPT_RWF: config->rwf_flags = parse_rwf(value); break;
+        case OPT_SHARED_FD: config->shared_fd = parse_flag(value); break;
+        case OPT_COMPARE_LSEEK: config->compare_lseek = parse_flag(value); break;
+        default: return 0;
+    }
+    return 1;
+}
+
+#define MAX_JOB_SECTIONS 64
+#define MAX_JOB_ENTRIES 64
+
+typedef struct {
+    char* key;
+    char* value;
+    int line;
+} job_entry;
+
+typedef struct {
+    char* name;
+    int parent;  // Section named by "inherit", -1 for none
+    int num_entries;
+    job_entry entries[MAX_JOB_ENTRIES];
+} job_section;
+
+char* trim(char* str) {
+    while (isspace((unsigned char)*str)) str++;
+    char* end = str + strlen(str);
+    while (end > str && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return str;
+}
+
+int find_job_section(job_section* sections, int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(sections[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// Parses an INI-style job file into sections; strings stay allocated for the life of the process
+int parse_job_file(const char* path, job_section* sections) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        perror("Failed to open job file");
+        exit(1);
+    }
+
+    int count = 0;
+    int line_no = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+        char* text = trim(line);
+        if (*text == '\0' || *text == '#' || *text == ';') {
+            continue;
+        }
+
+        if (*text == '[') {
+            char* close = strchr(text, ']');
+            if (!close || count == MAX_JOB_SECTIONS) {
+                fprintf(stderr, "Error: %s:%d: invalid section or too many sections\n", path, line_no);
                 exit(1);
             }
-            write_csv_header(csv_fp);
-        } else {
-            // File exists, open it in append mode
-            csv_fp = fopen(config.output_file, "a");
-            if (!csv_fp) {
-                perror("Failed to open output file");
+            *close = '\0';
+            job_section* section = &sections[count++];
+            section->name = strdup(trim(text + 1));
+            section->parent = -1;
+            section->num_entries = 0;
+            if (find_job_section(sections, count - 1, section->name) >= 0) {
+                fprintf(stderr, "Error: %s:%d: duplicate section [%s]\n", path, line_no, section->name);
+                exit(1);
+            }
+            continue;
+        }
+
+        char* equals = strchr(text, '=');
+        if (count == 0 || !equals) {
+            fprintf(stderr, "Error: %s:%d: expected key = value inside a section\n", path, line_no);
+            exit(1);
+        }
+        *equals = '\0';
+        char* key = trim(text);
+        char* value = trim(equals + 1);
+        job_section* section = &sections[count - 1];
+
+        if (strcmp(key, "inherit") == 0) {
+            // Only earlier sections can be inherited, which also rules out cycles
+            section->parent = find_job_section(sections, count - 1, value);
+            if (section->parent < 0) {
+                fprintf(stderr, "Error: %s:%d: [%s] inherits unknown section [%s]\n",
+                        path, line_no, section->name, value);
                 exit(1);
             }
+            continue;
         }
+        if (section->num_entries == MAX_JOB_ENTRIES) {
+            fprintf(stderr, "Error: %s:%d: too many keys in [%s]\n", path, line_no, section->name);
+            exit(1);
+        }
+        job_entry* entry = &section->entries[section->num_entries++];
+        entry->key = strdup(key);
+        entry->value = strdup(value);
+        entry->line = line_no;
     }
 
-    double results[config.num_iterations];
-    double sum = 0, sum_squared = 0;
+    fclose(fp);
+    return count;
+}
+
+// Applies a section on top of config and sweep, its inherited sections first
+void apply_job_section(job_section* sections, int index, const char* path,
+                       benchmark_config* config, sweep_spec* sweep) {
+    job_section* section = &sections[index];
+    if (section->parent >= 0) {
+        apply_job_section(sections, section->parent, path, config, sweep);
+    }
+    for (int i = 0; i < section->num_entries; i++) {
+        job_entry* entry = &section->entries[i];
+        int opt = 0;
+        for (const struct option* o = long_options; o->name; o++) {
+            if (strcmp(o->name, entry->key) == 0) {
+                opt = o->val;
+                break;
+            }
+        }
+        if (!apply_option(config, sweep, opt, entry->value)) {
+            fprintf(stderr, "Error: %s:%d: unknown key '%s'\n", path, entry->line, entry->key);
+            exit(1);
+        }
+    }
+}
 
-    for (int i = 0; i < config.num_iterations; i++) {
-        results[i] = run_benchmark(&config);
-        sum += results[i];
-        sum_squared += results[i] * results[i];
-        printf("Iteration %d: %.2f MB/s\n", i + 1, results[i]);
+// Runs every section of a job file except [global], which instead sets defaults for all of them
+void run_job_file(const char* path, benchmark_config* base, sweep_spec* base_sweep) {
+    job_section* sections = calloc(MAX_JOB_SECTIONS, sizeof(job_section));
+    if (!sections) {
+        perror("Failed to allocate job sections");
+        exit(1);
+    }
+    int count = parse_job_file(path, sections);
+    int global = find_job_section(sections, count, "global");
 
-        if (csv_fp) {
-            double mean = sum / (i + 1);
-            double variance = (sum_squared / (i + 1)) - (mean * mean);
-            double stddev = sqrt(variance);
-            double ci_95 = 1.96 * stddev / sqrt(i + 1);
-            write_csv_result(csv_fp, &config, i + 1, results[i], mean, stddev, ci_95);
+    for (int i = 0; i < count; i++) {
+        if (i == global) {
+            continue;
         }
+        benchmark_config config = *base;
+        sweep_spec sweep = *base_sweep;
+        if (global >= 0) {
+            apply_job_section(sections, global, path, &config, &sweep);
+        }
+        apply_job_section(sections, i, path, &config, &sweep);
+        run_job(&config, &sweep, sections[i].name);
     }
+    // Section strings are referenced by the configs until exit, so the sections are left allocated
+}
 
-    double mean = sum / config.num_iterations;
-    double variance = (sum_squared / config.num_iterations) - (mean * mean);
-    double stddev = sqrt(variance);
-    double ci_95 = 1.96 * stddev / sqrt(config.num_iterations);
+int main(int argc, char* argv[]) {
+    benchmark_config config = {
+            .device = NULL,
+            .io_size = 4 * KB,
+            .stride_size = 0,
+            .range = GB,
+            .is_write = 0,
+            .rwmix_read = -1,
+            .is_random = 0,
+            .dist = DIST_UNIFORM,
+            .zipf_theta = 0.99,
+            .pareto_h = 0.2,  // 80% of I/Os to 20% of the range
+            .hot_io_pct = 90,
+            .hot_range_pct = 10,
+            .num_iterations = 5,
+            .max_iterations = 100,
+            .steady_max_rounds = 25,
+            .log_interval_ms = 1000,
+            .hugepages = 1,
+            .sqpoll_cpu = -1,
+            .batch_complete = 1,
+            .num_iovecs = 1,
+            .output_file = NULL,
+            .io_multiplier = GB/4096,  // Default to 1GB worth of 4K blocks
+            .engine = ENGINE_SYNC,
+            .queue_depth = 1,
+            .num_threads = 1,
+            .seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32)
+    };
+    sweep_spec sweep = {
+            .io_sizes = {1, {4 * KB}},
+            .strides = {1, {0}},
+            .depths = {1, {1}}
+    };
+    const char* job_file = NULL;
+    buffer_pool pool = {0};
+    config.pool = &pool;
 
-    printf("\nResults Summary:\n");
-    printf("Average throughput: %.2f MB/s\n", mean);
-    printf("Standard deviation: %.2f MB/s\n", stddev);
-    printf("95%% Confidence Interval: %.2f ± %.2f MB/s\n", mean, ci_95);
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:s:t:r:wRn:o:m:e:q:j:h", long_options, NULL)) != -1) {
+        if (opt == OPT_JOB) {
+            job_file = optarg;
+        } else if (opt == 'h' || !apply_option(&config, &sweep, opt, optarg)) {
+            print_usage();
+            exit(1);
+        }
+    }
 
-    if (csv_fp) {
-        fclose(csv_fp);
-        printf("CSV output written to %s\n", config.output_file);
+    // Command-line options are the defaults a job file builds on
+    if (job_file) {
+        run_job_file(job_file, &config, &sweep);
+    } else {
+        run_job(&config, &sweep, NULL);
     }
 
+    pool_release(&pool);
     return 0;
-}
\ No newline at end of file
+}